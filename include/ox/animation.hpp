@@ -0,0 +1,98 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <optional>
+
+namespace ox::detail {
+
+/**
+ * Resumes \p h during the next frame, before it is painted. Starts the frame clock if
+ * no Animation is running. Must be called from the event loop thread.
+ */
+void resume_on_next_frame(std::coroutine_handle<> h);
+
+}  // namespace ox::detail
+
+namespace ox {
+class Widget;
+
+/**
+ * Calls `Widget::animate(dt)` once per frame while running, with the real time elapsed.
+ *
+ * @details All running Animations share one frame clock driven by the event loop in
+ * `Application::run()`, there is no thread per Animation. Each frame the Widgets of
+ * every running Animation are animated and then painted. When no Animation is running
+ * the clock stops and the event loop sleeps until the next Event.
+ *
+ * Because `dt` is measured, an animation written in terms of `dt` keeps its speed when
+ * frames are late. Animations are not thread safe, start and stop them from event
+ * handlers.
+ *
+ * The Widget lifetime is handled by a `LifetimeView`, as with Timer.
+ */
+class Animation {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Time between frames while any Animation is running.
+    static inline auto frame_interval =
+        std::chrono::duration_cast<Clock::duration>(std::chrono::milliseconds{16});
+
+   public:
+    /**
+     * Create an Animation for the given Widget.
+     *
+     * @param w The Widget to animate, typically `*this` if owned by the Widget.
+     * @param launch If true, the Animation will be started immediately.
+     */
+    explicit Animation(Widget& w, bool launch = false);
+
+    Animation(Animation const&) = delete;
+    Animation(Animation&& other);
+
+    auto operator=(Animation const&) -> Animation& = delete;
+    auto operator=(Animation&& other) -> Animation&;
+
+    /**
+     * Stop the Animation if it is running.
+     */
+    ~Animation();
+
+   public:
+    /**
+     * Start calling `Widget::animate(dt)` every frame.
+     * @details The first `dt` is measured from this call. Does nothing if running.
+     */
+    void start();
+
+    /**
+     * Stop calling `Widget::animate(dt)`.
+     * @details Can be called from within `Widget::animate(dt)`.
+     */
+    void stop();
+
+    [[nodiscard]] auto is_running() const -> bool { return is_running_; }
+
+   public:
+    /**
+     * Returns the time the next frame is due, std::nullopt if no Animation is running
+     * and no coroutine is waiting on `ox::next_frame()`.
+     */
+    [[nodiscard]] static auto next_frame() -> std::optional<Clock::time_point>;
+
+    /**
+     * Animate the Widget of every running Animation, passing each the time elapsed
+     * since its previous frame, or since it was started.
+     * @param now The time of this frame.
+     */
+    static void tick(Clock::time_point now);
+
+   private:
+    inline static int next_id_ = 0;
+
+    int id_;
+    bool is_running_ = false;
+};
+
+}  // namespace ox
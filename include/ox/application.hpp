@@ -1,11 +1,158 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
 #include <map>
+#include <memory>
 #include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include <ox/animation.hpp>
 #include <ox/core/core.hpp>
+#include <ox/thread_pool.hpp>
+#include <ox/timer.hpp>
 #include <ox/widget.hpp>
 
+namespace ox::detail {
+
+/**
+ * Passes an exception thrown by submitted work to `Task::exception_handler`, or calls
+ * std::terminate() if it is empty. Called on the event loop thread.
+ */
+void handle_submit_exception(std::exception_ptr error) noexcept;
+
+/// Lifetime for a submit() that isn't tied to a Widget.
+struct NoLifetime {
+    [[nodiscard]] auto valid() const -> bool { return true; }
+};
+
+/**
+ * Job for Application::submit, runs `fn` on a worker and posts `on_done` back.
+ *
+ * @details Owned by its queued event once `fn` has run, so it is deleted with that
+ * event even if the event is never handled. If `lifetime` has expired the job stops at
+ * the next step: before running `fn`, before posting, or before calling `on_done`. A
+ * job cancelled by the ThreadPool is deleted without running `fn`.
+ */
+template <typename Fn, typename OnDone, typename Lifetime>
+class SubmitJob : public PoolJob {
+   public:
+    using Result = std::invoke_result_t<Fn&>;
+
+   public:
+    SubmitJob(Fn fn, OnDone on_done, Lifetime lifetime)
+        : fn_{std::move(fn)},
+          on_done_{std::move(on_done)},
+          lifetime_{std::move(lifetime)}
+    {}
+
+   public:
+    void run() override
+    {
+        auto self = std::unique_ptr<SubmitJob>{this};
+        if (!lifetime_.valid()) { return; }
+        try {
+            if constexpr (std::is_void_v<Result>) { std::invoke(fn_); }
+            else {
+                result_.emplace(std::invoke(fn_));
+            }
+        }
+        catch (...) {
+            error_ = std::current_exception();
+        }
+        if (!lifetime_.valid()) { return; }
+        Terminal::event_queue.enqueue(event::Custom{
+            [job = std::move(self)]() -> EventResponse { return job->finish(); }});
+    }
+
+    void cancel() override { delete this; }
+
+   private:
+    /// Called on the event loop thread.
+    auto finish() -> EventResponse
+    {
+        if (!lifetime_.valid()) { return {}; }
+        if (error_) {
+            handle_submit_exception(error_);
+            return {};
+        }
+        if constexpr (std::is_void_v<Result>) { std::invoke(on_done_); }
+        else {
+            std::invoke(on_done_, std::move(*result_));
+        }
+        return {};
+    }
+
+   private:
+    Fn fn_;
+    OnDone on_done_;
+    Lifetime lifetime_;
+    std::conditional_t<std::is_void_v<Result>, bool, std::optional<Result>> result_;
+    std::exception_ptr error_;
+};
+
+/**
+ * The Widget tree in depth first order, kept between Tab and BackTab key presses.
+ *
+ * @details Built from the Widget tree on first use. Each search checks the children
+ * of every Widget it passes over, and of the ancestors that could gain a child inside
+ * the searched range, against the tree. The chain is rebuilt if any differ, so
+ * Widgets added, removed or moved since it was built are found. Focus policies are
+ * read from the Widgets on each search, they are not cached.
+ *
+ * A search is not O(1): it visits the children of each ancestor of the focused
+ * Widget, O(depth x fan-out), and of every entry passed over. This is still far less
+ * than the walk of the whole tree it replaces, which is only done on a rebuild.
+ */
+class FocusChain {
+   public:
+    /**
+     * Returns the Widget after \p current in Tab order, or before it if not \p forward.
+     *
+     * @details Wraps around at either end. If \p current is not in the tree below
+     * \p head, returns the first focusable Widget, or the last if not \p forward.
+     * Returns nullptr if no Widget can take Tab focus.
+     * @param head The root of the Widget tree the chain is built from.
+     */
+    [[nodiscard]] auto next(Widget& head, Widget const& current, bool forward)
+        -> Widget*;
+
+   private:
+    struct Entry {
+        Widget* widget;
+        LifetimeView<Widget> life;
+        std::size_t parent;  // Position in entries_, the root is its own parent.
+        std::size_t end;     // One past the position of the last descendant.
+    };
+
+   private:
+    void rebuild(Widget& head);
+
+    void append(Widget& w, std::size_t parent);
+
+    // Returns false if the Widget at \p at is gone or its children have changed.
+    [[nodiscard]] auto children_match(std::size_t at) const -> bool;
+
+    // Returns false if \p at or any of its ancestors fail children_match().
+    [[nodiscard]] auto ancestors_match(std::size_t at) const -> bool;
+
+    // Returns std::nullopt if the chain is out of date.
+    [[nodiscard]] auto find_next(Widget const& head,
+                                 Widget const& current,
+                                 bool forward) const -> std::optional<Widget*>;
+
+   private:
+    std::vector<Entry> entries_;
+    std::unordered_map<Widget const*, std::size_t> index_;  // Position in entries_.
+};
+
+}  // namespace ox::detail
+
 namespace ox {
 
 /**
@@ -13,8 +160,14 @@ namespace ox {
  */
 class Application {
    public:
+    /// The Widget a Timer sends events to, and the state shared with the Timer.
+    struct TimerTarget {
+        LifetimeView<Widget> widget;
+        std::shared_ptr<detail::TimerState> state;
+    };
+
     /// Map of Timer::id to target Widget.
-    static inline std::map<int, LifetimeView<Widget>> timer_targets;
+    static inline std::map<int, TimerTarget> timer_targets;
 
    public:
     /**
@@ -33,6 +186,47 @@ class Application {
      */
     static void quit(int code);
 
+    /**
+     * Worker threads for `submit()` and `ox::run_in_pool()`, started on first use.
+     */
+    [[nodiscard]] static auto thread_pool() -> ThreadPool&
+    {
+        static auto pool = ThreadPool{};
+        return pool;
+    }
+
+    /**
+     * Runs \p fn on the thread pool, then \p on_done on the event loop thread.
+     *
+     * @details \p on_done is passed the result of \p fn, or nothing if it returns
+     * void, and is followed by a paint. An exception thrown by \p fn is passed to
+     * `Task::exception_handler` on the event loop thread instead of calling \p on_done,
+     * std::terminate() is called if no handler is set.
+     * @param fn The work to run on a worker thread.
+     * @param on_done Called with the result on the event loop thread.
+     */
+    template <typename Fn, typename OnDone>
+    static void submit(Fn fn, OnDone on_done)
+    {
+        using Job = detail::SubmitJob<Fn, OnDone, detail::NoLifetime>;
+        thread_pool().push(*new Job{std::move(fn), std::move(on_done), {}});
+    }
+
+    /**
+     * Runs \p fn on the thread pool, then \p on_done on the event loop thread, only
+     * while the Widget tracked by \p lifetime is alive.
+     *
+     * @details If the Widget is destroyed the work is dropped at its next step: \p fn
+     * is not started, or its result is discarded without calling \p on_done.
+     */
+    template <typename Fn, typename OnDone, typename W>
+    static void submit(Fn fn, OnDone on_done, LifetimeView<W> lifetime)
+    {
+        using Job = detail::SubmitJob<Fn, OnDone, LifetimeView<W>>;
+        thread_pool().push(
+            *new Job{std::move(fn), std::move(on_done), std::move(lifetime)});
+    }
+
    public:
     auto handle_mouse_press(Mouse m) -> EventResponse;
 
@@ -50,12 +244,27 @@ class Application {
 
     auto handle_timer(int id) -> EventResponse;
 
+    /// Returns when the next Animation frame is due, std::nullopt if none are running.
+    [[nodiscard]] auto next_frame() const
+        -> std::optional<Animation::Clock::time_point>;
+
+    auto handle_frame(Animation::Clock::time_point now) -> EventResponse;
+
+    /**
+     * Paints the Widget tree, or with Terminal::PaintPolicy::retained only the Widgets
+     * updated since the previous paint.
+     */
     auto handle_paint(Canvas canvas) -> Terminal::Cursor;
 
    private:
     Widget& head_;
     Terminal term_;
     Point previous_mouse_position_{0, 0};
+    detail::FocusChain focus_chain_;
+
+    // Widget::update_count() as of the last retained paint, zero if none.
+    std::uint64_t painted_through_ = 0;
+    Terminal::Cursor cursor_ = std::nullopt;  // From the last retained paint.
     static std::optional<int> quit_request_;
 };
 
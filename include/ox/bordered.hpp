@@ -48,6 +48,7 @@ class Bordered : public Widget {
             .height = std::max(0, this->size.height - 2),
         };
         child.resize(old_size);
+        this->update();
     }
 
     void paint(Canvas c) override
@@ -67,11 +68,11 @@ class Bordered : public Widget {
         put(c, at, glyphs);
     }
 
-    auto get_children() -> zzz::Generator<Widget&> override { co_yield child; }
+    void for_each_child(FunctionRef<void(Widget&)> fn) override { fn(child); }
 
-    auto get_children() const -> zzz::Generator<Widget const&> override
+    void for_each_child(FunctionRef<void(Widget const&)> fn) const override
     {
-        co_yield child;
+        fn(child);
     }
 };
 
@@ -9,9 +9,9 @@
 
 #include <signals_light/signal.hpp>
 
+#include <ox/animation.hpp>
 #include <ox/core/core.hpp>
 #include <ox/label.hpp>
-#include <ox/timer.hpp>
 #include <ox/widget.hpp>
 
 namespace ox {
@@ -80,16 +80,14 @@ class Button : public BasicButton {
 
     void mouse_leave() override;
 
-    void timer() override;
+    void animate(std::chrono::nanoseconds dt) override;
 
    private:
-    static constexpr auto timer_period_ms = 10;
-
     struct FadeInternal {
         Fade fade;
         int direction = +1;  // +1 or -1
         float percent = 0.f;
-        Timer timer;
+        Animation animation;
     };
     using DecorationInternal = std::variant<PaintFn, FadeInternal>;
 
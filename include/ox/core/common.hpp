@@ -1,7 +1,12 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
 #include <ranges>
 #include <type_traits>
+#include <utility>
 
 namespace ox {
 
@@ -12,4 +17,160 @@ template <typename R, typename T>
 concept InputRangeOf =
     std::ranges::input_range<R> && std::same_as<std::ranges::range_value_t<R>, T>;
 
-}  // namespace ox
\ No newline at end of file
+template <typename Signature, std::size_t Capacity = 48>
+class InlineFunction;
+
+/**
+ * Move-only callable wrapper that stores callables of up to \p Capacity bytes inline.
+ *
+ * @details A replacement for std::function where a heap allocation per object matters.
+ * Callables that are larger, aligned beyond a pointer or not nothrow move constructible
+ * are stored on the heap instead, so any callable can be held. The call operator is
+ * const, as with std::function.
+ */
+template <typename R, typename... Args, std::size_t Capacity>
+class InlineFunction<R(Args...), Capacity> {
+   public:
+    InlineFunction() = default;
+
+    InlineFunction(std::nullptr_t) {}
+
+    template <typename Fn>
+        requires(!std::same_as<std::remove_cvref_t<Fn>, InlineFunction> &&
+                 std::is_invocable_r_v<R, std::decay_t<Fn>&, Args...>)
+    InlineFunction(Fn&& fn)
+    {
+        using F = std::decay_t<Fn>;
+        if constexpr (stored_inline<F>) {
+            ::new ((void*)storage_) F(std::forward<Fn>(fn));
+            ops_ = &inline_ops<F>;
+        }
+        else {
+            ::new ((void*)storage_) F*(new F(std::forward<Fn>(fn)));
+            ops_ = &heap_ops<F>;
+        }
+    }
+
+    InlineFunction(InlineFunction const&) = delete;
+
+    InlineFunction(InlineFunction&& other) noexcept : ops_{other.ops_}
+    {
+        if (ops_ != nullptr) {
+            ops_->move(other.storage_, storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    auto operator=(InlineFunction const&) -> InlineFunction& = delete;
+
+    auto operator=(InlineFunction&& other) noexcept -> InlineFunction&
+    {
+        if (this != &other) {
+            this->reset();
+            if (other.ops_ != nullptr) {
+                other.ops_->move(other.storage_, storage_);
+                ops_ = std::exchange(other.ops_, nullptr);
+            }
+        }
+        return *this;
+    }
+
+    ~InlineFunction() { this->reset(); }
+
+   public:
+    auto operator()(Args... args) const -> R
+    {
+        return ops_->invoke(storage_, std::forward<Args>(args)...);
+    }
+
+    [[nodiscard]] explicit operator bool() const { return ops_ != nullptr; }
+
+    /// Returns true if \p F would be stored without allocating.
+    template <typename F>
+    static constexpr bool stored_inline = sizeof(F) <= Capacity &&
+                                          alignof(F) <= alignof(void*) &&
+                                          std::is_nothrow_move_constructible_v<F>;
+
+   private:
+    struct Ops {
+        R (*invoke)(std::byte*, Args&&...);
+        void (*move)(std::byte* from, std::byte* to) noexcept;
+        void (*destroy)(std::byte*) noexcept;
+    };
+
+    template <typename F>
+    static constexpr auto inline_ops = Ops{
+        .invoke = [](std::byte* p, Args&&... args) -> R {
+            return std::invoke(*std::launder((F*)p), std::forward<Args>(args)...);
+        },
+        .move =
+            [](std::byte* from, std::byte* to) noexcept {
+                auto* const f = std::launder((F*)from);
+                ::new ((void*)to) F(std::move(*f));
+                f->~F();
+            },
+        .destroy = [](std::byte* p) noexcept { std::launder((F*)p)->~F(); },
+    };
+
+    template <typename F>
+    static constexpr auto heap_ops = Ops{
+        .invoke = [](std::byte* p, Args&&... args) -> R {
+            return std::invoke(**std::launder((F**)p), std::forward<Args>(args)...);
+        },
+        .move =
+            [](std::byte* from, std::byte* to) noexcept {
+                ::new ((void*)to) F*(*std::launder((F**)from));
+            },
+        .destroy = [](std::byte* p) noexcept { delete *std::launder((F**)p); },
+    };
+
+   private:
+    void reset()
+    {
+        if (ops_ != nullptr) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+   private:
+    Ops const* ops_ = nullptr;
+    // Pointer alignment keeps the object at sizeof(void*) + Capacity, without padding.
+    alignas(void*) mutable std::byte storage_[Capacity];
+};
+
+template <typename Signature>
+class FunctionRef;
+
+/**
+ * Non-owning reference to a callable, for passing callbacks without allocating.
+ *
+ * @details The referenced callable must outlive the FunctionRef, so this is meant for
+ * function parameters that are called before the function returns.
+ */
+template <typename R, typename... Args>
+class FunctionRef<R(Args...)> {
+   public:
+    template <typename Fn>
+        requires(!std::same_as<std::remove_cvref_t<Fn>, FunctionRef> &&
+                 std::is_invocable_r_v<R, Fn&, Args...>)
+    FunctionRef(Fn&& fn)
+        : object_{(void*)std::addressof(fn)},
+          invoke_{[](void* p, Args... args) -> R {
+              return std::invoke(*(std::remove_reference_t<Fn>*)p,
+                                 std::forward<Args>(args)...);
+          }}
+    {}
+
+   public:
+    auto operator()(Args... args) const -> R
+    {
+        return invoke_(object_, std::forward<Args>(args)...);
+    }
+
+   private:
+    void* object_;
+    R (*invoke_)(void*, Args...);
+};
+
+}  // namespace ox
@@ -1,13 +1,20 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
 #include <concepts>
 #include <condition_variable>
-#include <functional>
-#include <list>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
 #include <mutex>
+#include <new>
 #include <optional>
 #include <utility>
 #include <variant>
+#include <vector>
 
 #include <esc/event.hpp>
 #include <esc/key.hpp>
@@ -28,7 +35,11 @@ using ::esc::Mouse;
  * Thread safe queue for inter-thread communication.
  *
  * @details This is built specifically for Events where multiple threads enqueue and one
- * thread consumes.
+ * thread consumes. Producers push onto a lock-free stack with a single compare and
+ * swap, the consumer takes the whole stack at once and reverses it into FIFO order.
+ * Nodes are recycled through a lock-free pool, so enqueue does not allocate once the
+ * pool has grown to the queue's peak size. The mutex and condition variable are only
+ * used while the consumer sleeps on an empty queue.
  * @tparam T The type of element to store in the queue.
  */
 template <typename T>
@@ -45,21 +56,44 @@ class ConcurrentQueue {
     auto operator=(ConcurrentQueue const&) -> ConcurrentQueue& = delete;
     auto operator=(ConcurrentQueue&&) -> ConcurrentQueue& = delete;
 
+    ~ConcurrentQueue()
+    {
+        for (auto i : {pushed_.load(std::memory_order_acquire), taken_}) {
+            while (i != npos) {
+                auto& n = this->node(i);
+                n.value().~value_type();
+                i = n.next.load(std::memory_order_relaxed);
+            }
+        }
+        for (auto& chunk : chunks_) {
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+    }
+
    public:
     /**
      * Adds an element at the back of the queue.
      *
+     * @details Elements enqueued by the same thread are popped in the same order.
      * @param value The element to enqueue.
      */
     void enqueue(value_type value)
     {
-        auto tmp = std::list<value_type>{};
-        tmp.push_back(std::move(value));
-        {
-            auto const lock = std::scoped_lock{mutex_};
-            queue_.splice(std::end(queue_), tmp);
+        auto const i = this->acquire_node();
+        auto& n = this->node(i);
+        ::new ((void*)n.storage) value_type(std::move(value));
+
+        auto head = pushed_.load(std::memory_order_relaxed);
+        do {
+            n.next.store(head, std::memory_order_relaxed);
+        } while (!pushed_.compare_exchange_weak(head, i, std::memory_order_seq_cst,
+                                                std::memory_order_relaxed));
+
+        // Either the consumer sees the push before sleeping, or this sees it sleeping.
+        if (sleeping_.load(std::memory_order_seq_cst)) {
+            { auto const lock = std::scoped_lock{mutex_}; }
+            cond_.notify_one();
         }
-        cond_.notify_one();
     }
 
     /**
@@ -70,18 +104,220 @@ class ConcurrentQueue {
      */
     [[nodiscard]] auto pop() -> value_type
     {
-        auto lock = std::unique_lock{mutex_};
-        cond_.wait(lock, [this] { return !queue_.empty(); });
-        // After the wait, the lock is re-acquired.
-        auto value = std::move(queue_.front());
-        queue_.pop_front();
+        while (true) {
+            if (auto value = this->try_pop(); value.has_value()) {
+                return std::move(*value);
+            }
+            auto lock = std::unique_lock{mutex_};
+            sleeping_.store(true, std::memory_order_seq_cst);
+            cond_.wait(lock, [this] { return this->has_pushed(); });
+            sleeping_.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Removes and retrieves the element at the front of the queue, if there is one.
+     *
+     * @details This does not block.
+     * @return std::optional<value_type> The element at the front of the queue, or
+     * std::nullopt if the queue is empty.
+     */
+    [[nodiscard]] auto try_pop() -> std::optional<value_type>
+    {
+        if (taken_ == npos) { this->take_pushed(); }
+        if (taken_ == npos) { return std::nullopt; }
+
+        auto const i = taken_;
+        auto& n = this->node(i);
+        taken_ = n.next.load(std::memory_order_relaxed);
+        auto value = std::optional<value_type>{std::move(n.value())};
+        n.value().~value_type();
+        this->release_node(i);
         return value;
     }
 
+    /**
+     * Removes and retrieves the element at the front of the queue, waiting until
+     * \p deadline for one to become available.
+     *
+     * @param deadline The point in time to stop waiting at.
+     * @return std::optional<value_type> The element at the front of the queue, or
+     * std::nullopt if the queue is still empty at the deadline.
+     */
+    template <typename Clock, typename Duration>
+    [[nodiscard]] auto try_pop_until(
+        std::chrono::time_point<Clock, Duration> const& deadline)
+        -> std::optional<value_type>
+    {
+        if (auto value = this->try_pop(); value.has_value()) { return value; }
+        {
+            auto lock = std::unique_lock{mutex_};
+            sleeping_.store(true, std::memory_order_seq_cst);
+            cond_.wait_until(lock, deadline, [this] { return this->has_pushed(); });
+            sleeping_.store(false, std::memory_order_relaxed);
+        }
+        return this->try_pop();
+    }
+
+    /**
+     * Removes and retrieves the element at the front of the queue, waiting up to
+     * \p timeout for one to become available.
+     *
+     * @param timeout The longest time to wait for.
+     * @return std::optional<value_type> The element at the front of the queue, or
+     * std::nullopt if the queue is still empty after the timeout.
+     */
+    template <typename Rep, typename Period>
+    [[nodiscard]] auto try_pop_for(std::chrono::duration<Rep, Period> const& timeout)
+        -> std::optional<value_type>
+    {
+        return this->try_pop_until(std::chrono::steady_clock::now() + timeout);
+    }
+
+    /**
+     * Removes every element currently in the queue and appends them to \p out.
+     *
+     * @details This does not block. Everything enqueued so far is taken with a single
+     * atomic exchange, in the same order pop() would return it.
+     * @param out A container with push_back(value_type&&).
+     * @return std::size_t The number of elements appended.
+     */
+    template <typename Container>
+    auto drain(Container& out) -> std::size_t
+    {
+        auto count = std::size_t{0};
+        // Elements taken by an earlier pop come first, then everything pushed since.
+        for (auto pass = 0; pass < 2; ++pass) {
+            while (taken_ != npos) {
+                auto const i = taken_;
+                auto& n = this->node(i);
+                out.push_back(std::move(n.value()));
+                taken_ = n.next.load(std::memory_order_relaxed);
+                n.value().~value_type();
+                this->release_node(i);
+                ++count;
+            }
+            this->take_pushed();
+        }
+        return count;
+    }
+
+    /**
+     * Removes and returns every element currently in the queue, oldest first.
+     *
+     * @details This does not block, the returned vector is empty if the queue is.
+     */
+    [[nodiscard]] auto pop_all() -> std::vector<value_type>
+    {
+        auto values = std::vector<value_type>{};
+        this->drain(values);
+        return values;
+    }
+
+   private:
+    static constexpr auto npos = std::uint32_t(-1);
+    static constexpr auto first_chunk_size = std::size_t{64};
+
+    struct Node {
+        std::atomic<std::uint32_t> next{npos};
+        alignas(value_type) std::byte storage[sizeof(value_type)];
+
+        [[nodiscard]] auto value() -> value_type&
+        {
+            return *std::launder(reinterpret_cast<value_type*>(storage));
+        }
+    };
+
+    /**
+     * Nodes are stored in chunks that double in size, so indices stay valid forever.
+     */
+    [[nodiscard]] auto node(std::uint32_t i) -> Node&
+    {
+        auto const chunk = (std::size_t)std::bit_width(i / first_chunk_size + 1) - 1;
+        auto const offset = i - first_chunk_size * ((std::size_t{1} << chunk) - 1);
+        return chunks_[chunk].load(std::memory_order_acquire)[offset];
+    }
+
+    [[nodiscard]] auto has_pushed() const -> bool
+    {
+        return pushed_.load(std::memory_order_seq_cst) != npos;
+    }
+
+    /**
+     * Moves everything pushed so far into taken_, oldest first. Consumer only.
+     */
+    void take_pushed()
+    {
+        auto i = pushed_.exchange(npos, std::memory_order_acquire);
+        auto reversed = npos;
+        while (i != npos) {
+            auto& n = this->node(i);
+            auto const next = n.next.load(std::memory_order_relaxed);
+            n.next.store(reversed, std::memory_order_relaxed);
+            reversed = i;
+            i = next;
+        }
+        taken_ = reversed;
+    }
+
+    // The free list head is tagged with a counter so a node popped and pushed back
+    // between a producer's load and compare and swap is not mistaken for no change.
+    [[nodiscard]] static auto tagged(std::uint32_t index, std::uint32_t tag)
+        -> std::uint64_t
+    {
+        return (std::uint64_t)tag << 32 | index;
+    }
+
+    [[nodiscard]] auto acquire_node() -> std::uint32_t
+    {
+        auto free = free_.load(std::memory_order_acquire);
+        while ((std::uint32_t)free != npos) {
+            auto const i = (std::uint32_t)free;
+            auto const next = this->node(i).next.load(std::memory_order_relaxed);
+            auto const tag = (std::uint32_t)(free >> 32) + 1;
+            if (free_.compare_exchange_weak(free, tagged(next, tag),
+                                            std::memory_order_acquire,
+                                            std::memory_order_acquire)) {
+                return i;
+            }
+        }
+
+        // Pool is empty, take a fresh node, allocating its chunk if this is the first.
+        auto const i = allocated_.fetch_add(1, std::memory_order_relaxed);
+        auto const chunk = (std::size_t)std::bit_width(i / first_chunk_size + 1) - 1;
+        if (chunks_[chunk].load(std::memory_order_acquire) == nullptr) {
+            auto const lock = std::scoped_lock{chunk_mutex_};
+            if (chunks_[chunk].load(std::memory_order_relaxed) == nullptr) {
+                chunks_[chunk].store(new Node[first_chunk_size << chunk],
+                                     std::memory_order_release);
+            }
+        }
+        return i;
+    }
+
+    void release_node(std::uint32_t i)
+    {
+        auto& n = this->node(i);
+        auto free = free_.load(std::memory_order_relaxed);
+        do {
+            n.next.store((std::uint32_t)free, std::memory_order_relaxed);
+        } while (!free_.compare_exchange_weak(
+            free, tagged(i, (std::uint32_t)(free >> 32) + 1), std::memory_order_release,
+            std::memory_order_relaxed));
+    }
+
    private:
-    mutable std::mutex mutex_;
+    std::atomic<std::uint32_t> pushed_{npos};  // Newest first.
+    std::uint32_t taken_ = npos;               // Oldest first, consumer only.
+
+    std::atomic<std::uint64_t> free_{tagged(npos, 0)};
+    std::atomic<std::uint32_t> allocated_{0};
+    std::array<std::atomic<Node*>, 27> chunks_{};  // Enough for every 32 bit index.
+    std::mutex chunk_mutex_;
+
+    std::atomic<bool> sleeping_{false};
+    std::mutex mutex_;
     std::condition_variable cond_;
-    std::list<value_type> queue_;
 };
 
 // Event Handler Response
@@ -113,8 +349,14 @@ struct Timer {
     int id;
 };
 
+/// Runs `action` on the event loop thread, captures of up to 48 bytes don't allocate.
 struct Custom {
-    std::function<EventResponse()> action;
+    InlineFunction<EventResponse()> action;
+};
+
+/// Resumes a suspended coroutine, such as an ox::Task, on the event loop thread.
+struct Resume {
+    std::coroutine_handle<> handle;
 };
 
 struct Interrupt {};
@@ -130,8 +372,12 @@ using Event = std::variant<esc::MousePress,
                            esc::Resize,
                            event::Timer,
                            event::Custom,
+                           event::Resume,
                            event::Interrupt>;
 
+// Events are moved through the EventQueue, keep each within a single cache line.
+static_assert(sizeof(Event) <= 64);
+
 /**
  * A thread-safe queue of Events.
  */
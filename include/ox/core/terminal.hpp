@@ -1,10 +1,18 @@
 #pragma once
 
 #include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <stop_token>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <type_traits>
 #include <variant>
@@ -23,6 +31,92 @@
 #include <ox/core/events.hpp>
 #include <ox/core/glyph.hpp>
 
+namespace ox::detail {
+
+/**
+ * Append the SGR sequences that change the terminal's Brush from \p from to \p to.
+ *
+ * @details Only the colors that differ are written. If the Traits differ, every Trait
+ * is turned off without touching the colors and the new Traits are written, so removed
+ * Traits are handled without a full reset.
+ * @param out The string to append the escape sequences to.
+ * @param from The Brush the terminal currently has.
+ * @param to The Brush to change the terminal to.
+ */
+void append_sgr_delta(std::string& out, Brush const& from, Brush const& to);
+
+/**
+ * Writes frames to the terminal from a dedicated thread.
+ *
+ * @details Frames are double buffered: the thread writes one buffer while the next
+ * frame is handed over in the other. Frames submitted while the thread is busy are
+ * appended to the pending buffer, so every frame is written, in order, unless the
+ * pending frame is retracted. A frame is written once it has drained to the terminal.
+ */
+class FrameWriter {
+   public:
+    /**
+     * Starts the writer thread.
+     *
+     * @param output Passed each frame instead of writing it to stdout, if set.
+     */
+    explicit FrameWriter(std::function<void(std::string_view)> output = nullptr);
+
+    /**
+     * Writes all submitted frames, then stops the writer thread.
+     */
+    ~FrameWriter();
+
+    FrameWriter(FrameWriter const&) = delete;
+    auto operator=(FrameWriter const&) -> FrameWriter& = delete;
+
+   public:
+    /**
+     * Hand a finished frame to the writer thread.
+     *
+     * @param frame The escape sequence to write. If the thread is idle this is swapped
+     * with the previously written buffer, left empty with its capacity kept.
+     */
+    void submit(std::string& frame);
+
+    /**
+     * Blocks until every submitted frame has been written and flushed.
+     */
+    void wait();
+
+    /**
+     * Returns true if the thread is still writing a frame and none is pending, so a
+     * frame submitted now would have to wait for the terminal to catch up.
+     */
+    [[nodiscard]] auto would_wait() -> bool;
+
+    /**
+     * Removes the pending frame if the thread has not started writing it.
+     *
+     * @return true if a frame was removed.
+     */
+    auto retract() -> bool;
+
+   private:
+    void run(std::stop_token st);
+
+   private:
+    std::mutex mtx_;
+    std::condition_variable_any frame_ready_;
+    std::condition_variable frame_written_;
+    std::string pending_;   // Guarded by mtx_.
+    bool writing_ = false;  // Guarded by mtx_.
+    std::function<void(std::string_view)> output_;
+    std::jthread thread_;
+};
+
+/**
+ * Posts `event::Resume{h}` once \p fd is readable, polled by the Terminal input thread.
+ */
+void resume_when_readable(int fd, std::coroutine_handle<> h);
+
+}  // namespace ox::detail
+
 namespace ox {
 
 using ::esc::Area;
@@ -35,6 +129,19 @@ using ::esc::Signals;
  * A 2D Matrix of Glyphs that represents a paintable screen.
  */
 class ScreenBuffer {
+   public:
+    /**
+     * A half open range of columns `[begin, end)` within a single row.
+     *
+     * @details An empty Span has `begin >= end`.
+     */
+    struct Span {
+        int begin;
+        int end;
+
+        [[nodiscard]] auto empty() const -> bool { return begin >= end; }
+    };
+
    public:
     /**
      * Construct a ScreenBuffer with the given dimensions.
@@ -48,7 +155,8 @@ class ScreenBuffer {
      * Access the Glyph at the given position.
      *
      * @details The top left is `{0, 0}` and the bottom right is `{width - 1, height -
-     * 1}`. Does no bounds checking.
+     * 1}`. Does no bounds checking. The position is recorded as damaged, since the
+     * returned reference can be written to.
      * @param p The Point position of the Glyph.
      * @return Glyph& A reference to the Glyph at the given position.
      */
@@ -68,7 +176,7 @@ class ScreenBuffer {
      * Resize the ScreenBuffer to the given dimensions.
      *
      * @details This does not preserve the contents of the ScreenBuffer, the buffer is
-     * left in an undefined state.
+     * left in an undefined state. The entire buffer is marked as damaged.
      * @param a The new dimensions of the ScreenBuffer.
      */
     void resize(Area a);
@@ -76,6 +184,7 @@ class ScreenBuffer {
     /**
      * Fill the ScreenBuffer with the given Glyph.
      *
+     * @details The entire buffer is marked as damaged.
      * @param g The Glyph to fill the ScreenBuffer with.
      */
     void fill(Glyph const& g);
@@ -87,9 +196,67 @@ class ScreenBuffer {
      */
     [[nodiscard]] auto size() const -> Area { return size_; }
 
+    /**
+     * Return the columns of row \p y that have been written to since the last call to
+     * `clear_damage()`.
+     *
+     * @details This is a single Span covering every written cell in the row, it may
+     * include cells in between that were not written to. Does no bounds checking.
+     * @param y The row to query.
+     */
+    [[nodiscard]] auto damage(int y) const -> Span
+    {
+        return damage_[(std::size_t)y];
+    }
+
+    /**
+     * Record each cell written to, as well as the damaged Span of each row.
+     *
+     * @details Off by default, since it adds a store to every write. Cells in the
+     * damaged Spans are marked as written when this is enabled.
+     * @param enabled Whether to record written cells.
+     */
+    void track_written(bool enabled);
+
+    /**
+     * Return true if the cell at \p p has been written to since the last call to
+     * `clear_damage()`.
+     *
+     * @details Only recorded while `track_written(true)` is in effect, otherwise this
+     * returns whether \p p is within the damaged Span of its row. Does no bounds
+     * checking.
+     */
+    [[nodiscard]] auto written(Point p) const -> bool
+    {
+        if (track_written_) { return written_[(std::size_t)(p.y * size_.width + p.x)]; }
+        auto const span = damage_[(std::size_t)p.y];
+        return span.begin <= p.x && p.x < span.end;
+    }
+
+    /**
+     * Return the number of cells covered by the damaged Spans of every row.
+     */
+    [[nodiscard]] auto damage_count() const -> std::size_t;
+
+    /**
+     * Mark every row as undamaged, does not modify any Glyphs.
+     */
+    void clear_damage();
+
+    /**
+     * Assign \p g to each cell in the damaged Spans, then clear the damage.
+     *
+     * @details This is equivalent to `fill(g)` followed by `clear_damage()` when every
+     * cell outside of the damaged Spans already holds \p g.
+     */
+    void reset_damaged(Glyph const& g);
+
    private:
     Area size_;
     std::vector<Glyph> buffer_;
+    std::vector<Span> damage_;  // One Span per row.
+    bool track_written_ = false;
+    std::vector<bool> written_;  // One per cell while track_written_ is set.
 };
 
 /**
@@ -99,12 +266,83 @@ class Terminal {
    public:
     using Cursor = std::optional<Point>;
 
+    /**
+     * Optional terminal features used by `commit_changes()` to reduce output size.
+     *
+     * @details Each feature falls back to plain cell writes when disabled.
+     * scroll_region: DECSTBM margins with SU/SD to move vertically shifted rows.
+     * erase: ECH and EL for runs of blank cells. Off by default, the terminal must
+     * erase with the current background color (bce), or erased cells show the wrong
+     * color.
+     * repeat: REP for runs of an identical Glyph, not supported by all terminals.
+     * synchronized_output: Wrap each frame in DEC mode 2026 begin/end sequences so the
+     * terminal presents it atomically. Support is queried at construction, this is
+     * left false if the terminal does not report the mode.
+     */
+    struct Capabilities {
+        bool scroll_region = true;
+        bool erase = false;
+        bool repeat = false;
+        bool synchronized_output = false;
+    };
+
+    /**
+     * How `process_events()` batches events between paints.
+     *
+     * @details
+     * coalesce: Handle every queued event, up to `budget`, before painting once.
+     * budget: The longest time spent handling queued events before a paint is forced.
+     * max_frame_rate: Upper limit on paints per second, zero for no limit. Events that
+     * arrive before the next frame is due are handled without painting.
+     * retained: `commit_changes()` leaves the cells of `changes` in place instead of
+     * clearing them, so a handler only has to repaint what has changed since the last
+     * frame. The Application then only repaints Widgets marked with `Widget::update()`.
+     */
+    struct PaintPolicy {
+        bool coalesce = false;
+        std::chrono::milliseconds budget{16};
+        int max_frame_rate = 0;
+        bool retained = false;
+    };
+
+    /**
+     * Input events that `process_events()` may collapse into the latest of a run.
+     *
+     * @details
+     * mouse_move: Consecutive MouseMove events with the same button and modifiers are
+     * collapsed into the last one, intermediate positions are not reported.
+     * resize: Consecutive Resize events are collapsed into the last one.
+     */
+    struct EventCoalescing {
+        bool mouse_move = false;
+        bool resize = false;
+    };
+
     struct Options {
         MouseMode mouse_mode = MouseMode::Basic;
         KeyMode key_mode = KeyMode::Normal;
         Signals signals = Signals::On;
         Color foreground = TermColor::Default;
         Color background = TermColor::Default;
+        Capabilities capabilities = {};
+        bool threaded_output = false;  // Write frames from a detail::FrameWriter.
+        PaintPolicy paint_policy = {};
+        EventCoalescing event_coalescing = {};
+
+        // Passed each frame instead of stdout. When set the terminal is left untouched,
+        // it is not initialized and no input is read, so frames can be checked offline.
+        std::function<void(std::string_view)> output = nullptr;
+    };
+
+    /**
+     * Rendering statistics for a single call to `commit_changes()`.
+     */
+    struct FrameStats {
+        std::size_t dirty_cells = 0;    // Cells diffed against the current screen.
+        std::size_t changed_cells = 0;  // Cells that differed and were written.
+        int scrolled_rows = 0;          // Rows moved by a scroll region, +up/-down.
+        std::size_t bytes = 0;          // Size of the escape sequence written.
+        bool coalesced = false;         // Replaced a frame that was never written.
     };
 
    public:
@@ -113,6 +351,9 @@ class Terminal {
 
     Color foreground = TermColor::Default;
     Color background = TermColor::Default;
+    Capabilities capabilities = {};
+    PaintPolicy paint_policy = {};
+    EventCoalescing event_coalescing = {};
 
     /**
      * The current cursor position on the terminal.
@@ -159,7 +400,8 @@ class Terminal {
      * Write changes ScreenBuffer to the terminal and update current_screen_.
      *
      * @details This is called automatically by the Application class after an event has
-     * been processed.
+     * been processed. With Options::threaded_output the finished frame is handed to the
+     * writer thread and this returns without waiting for it to be written.
      */
     void commit_changes();
 
@@ -167,10 +409,34 @@ class Terminal {
      * Runs a loop that reads input from the terminal and appends it to the
      * Terminal::event_queue. Exits when the stop_token is stop_requested().
      *
+     * @details Blocks in poll() between inputs. Stop requests and signals wake it
+     * through a self-pipe rather than a timeout.
+     *
      * @param st The stop_token to check for stop_requested().
      */
     void run_read_loop(std::stop_token st);
 
+    /**
+     * Calls \p on_ready on the event loop thread each time \p fd is readable.
+     *
+     * @details \p fd is polled by the input thread along with stdin, no thread is
+     * created per fd. Readiness is delivered as an `event::Custom`, and \p fd is not
+     * polled again until \p on_ready has returned, so it should read what is available.
+     * Hang-ups and errors are reported as readiness. The watch is dropped if \p fd is
+     * closed before `unwatch()` is called.
+     * @param fd An open file descriptor, ownership is not taken.
+     * @param on_ready Passed \p fd, its response is handled like any Event handler's.
+     * @return An id to pass to `unwatch()`.
+     */
+    static auto watch(int fd, std::function<EventResponse(int)> on_ready) -> int;
+
+    /**
+     * Stops watching the fd registered with the given id from `watch()`.
+     * @details An event already queued for it is discarded. Safe to call from within
+     * its `on_ready` callback.
+     */
+    static void unwatch(int id);
+
     /**
      * Returns the current size of the terminal.
      *
@@ -178,10 +444,29 @@ class Terminal {
      */
     [[nodiscard]] auto size() -> Area;
 
+    /**
+     * Returns the statistics of the most recent `commit_changes()` call.
+     */
+    [[nodiscard]] auto frame_stats() const -> FrameStats { return frame_stats_; }
+
    private:
     ScreenBuffer current_screen_{{0, 0}};
+    std::vector<std::uint64_t> current_hashes_;  // Row hashes of current_screen_.
     std::jthread terminal_input_thread_;
     std::string escape_sequence_;
+    std::unique_ptr<detail::FrameWriter> frame_writer_;  // Null if writing inline.
+    std::function<void(std::string_view)> output_;       // Replaces stdout if set.
+
+    // The screen the pending frame of frame_writer_ was diffed against, if the frame
+    // can be retracted and replaced.
+    std::optional<ScreenBuffer> base_screen_;
+    std::vector<std::uint64_t> base_hashes_;
+
+    // Damage from the previous frame, its cells must be diffed again to be cleared.
+    std::vector<ScreenBuffer::Span> previous_damage_;
+    Color previous_foreground_ = TermColor::Default;
+    Color previous_background_ = TermColor::Default;
+    FrameStats frame_stats_;
 };
 
 /**
@@ -212,6 +497,19 @@ struct Canvas {
     [[nodiscard]] auto operator[](Point p) const -> Glyph const&;
 };
 
+/**
+ * Returns true if \p event can be dropped because \p next replaces it.
+ *
+ * @details Only MouseMove and Resize events are replaced, as enabled by \p coalescing.
+ * A MouseMove is only replaced by a MouseMove with the same button and modifiers.
+ * @param event The earlier Event.
+ * @param next The Event that immediately follows \p event.
+ * @param coalescing Which Event types may be collapsed.
+ */
+[[nodiscard]] auto is_superseded(Event const& event,
+                                 Event const& next,
+                                 Terminal::EventCoalescing const& coalescing) -> bool;
+
 /**
  * Calls the appropriate handler function on \p handler for the given Event.
  *
@@ -297,6 +595,10 @@ template <typename T>
                       [](event::Custom const& e) -> std::optional<EventResponse> {
                           return e.action();
                       },
+                      [](event::Resume e) -> std::optional<EventResponse> {
+                          e.handle.resume();
+                          return EventResponse{};
+                      },
                       [](event::Interrupt) -> std::optional<EventResponse> {
                           return QuitRequest{1};
                       }},
@@ -308,12 +610,26 @@ concept HandlesPaint = requires(T t, Canvas c) {
     { t.handle_paint(c) } -> std::same_as<Terminal::Cursor>;
 };
 
+/**
+ * Checks if a type runs a frame clock, `next_frame()` returns std::nullopt when idle.
+ */
+template <typename T>
+concept HandlesFrame = requires(T t, std::chrono::steady_clock::time_point now) {
+    {
+        t.next_frame()
+    } -> std::same_as<std::optional<std::chrono::steady_clock::time_point>>;
+    { t.handle_frame(now) } -> std::same_as<EventResponse>;
+};
+
 /**
  * Runs an event loop over the Terminal::event_queue, sending events to the given event
  * handler.
  *
  * @details This will block until it receives a QuitRequest. The application can be quit
- * by responding to an Event handler with a QuitRequest object.
+ * by responding to an Event handler with a QuitRequest object. Painting is batched
+ * according to `term.paint_policy`, by default every handled event is painted. If the
+ * handler has a frame clock, `handle_frame` is called and painted each time a frame is
+ * due, the loop otherwise blocks on the EventQueue.
  * @param term The Terminal object.
  * @param handler The handler object that all events will be sent to.
  * @return The return code of the application, passed in via QuitRequest.
@@ -321,23 +637,124 @@ concept HandlesPaint = requires(T t, Canvas c) {
 template <typename EventHandler>
 [[nodiscard]] auto process_events(Terminal& term, EventHandler& handler) -> int
 {
-    while (true) {
-        auto const event = Terminal::event_queue.pop();  // Blocking Call
+    using Clock = std::chrono::steady_clock;
+
+    auto needs_paint = false;
+    auto last_paint = Clock::time_point{};
+
+    // Returns the return code if the handler responded with a QuitRequest.
+    auto const handle = [&](Event const& event) -> std::optional<int> {
         auto const result = apply_event(event, handler, term.changes);
+        if (!result.has_value()) { return std::nullopt; }
+        if (auto& quit = *result; quit.has_value()) { return quit->return_code; }
+        needs_paint = true;
+        return std::nullopt;
+    };
 
-        if (result.has_value()) {
-            if (auto& quit = *result; quit.has_value()) { return quit->return_code; }
-            else {
-                if constexpr (HandlesPaint<EventHandler>) {
-                    term.cursor = handler.handle_paint(Canvas{
-                        .buffer = term.changes,
-                        .at = {0, 0},
-                        .size = term.changes.size(),
-                    });
+    // Calls handle_frame if the handler's next frame is due.
+    auto const tick_frame = [&]() -> std::optional<int> {
+        if constexpr (HandlesFrame<EventHandler>) {
+            auto const due = handler.next_frame();
+            if (!due.has_value()) { return std::nullopt; }
+            if (auto const now = Clock::now(); *due <= now) {
+                if (auto const quit = handler.handle_frame(now); quit.has_value()) {
+                    return quit->return_code;
                 }
-                term.commit_changes();
+                needs_paint = true;
+            }
+        }
+        return std::nullopt;
+    };
+
+    // Blocks until an Event arrives, or until the next frame is due.
+    auto const wait = [&]() -> std::optional<Event> {
+        if constexpr (HandlesFrame<EventHandler>) {
+            if (auto const due = handler.next_frame(); due.has_value()) {
+                return Terminal::event_queue.try_pop_until(*due);
             }
         }
+        return Terminal::event_queue.pop();
+    };
+
+    // Events drained from the queue that have not been handled yet, from batch[next].
+    auto batch = std::vector<Event>{};
+    auto next = std::size_t{0};
+
+    // Handles batch[next], skipping it while the event after it replaces it.
+    auto const handle_next = [&]() -> std::optional<int> {
+        auto const coalescing = term.event_coalescing;
+        if (coalescing.mouse_move || coalescing.resize) {
+            while (true) {
+                if (next + 1 == batch.size()) { Terminal::event_queue.drain(batch); }
+                if (next + 1 == batch.size() ||
+                    !is_superseded(batch[next], batch[next + 1], coalescing)) {
+                    break;
+                }
+                ++next;
+            }
+        }
+        return handle(batch[next++]);
+    };
+
+    while (true) {
+        auto const policy = term.paint_policy;
+
+        if (next == batch.size()) {
+            batch.clear();
+            next = 0;
+            if (auto event = wait()) { batch.push_back(std::move(*event)); }
+        }
+        if (next < batch.size()) {
+            if (auto const code = handle_next()) { return *code; }
+        }
+
+        // Checked after every event, so frames keep their rate while events flood in.
+        if (auto const code = tick_frame()) { return *code; }
+
+        if (policy.coalesce) {
+            // Everything queued is taken at once and handled until the budget runs out.
+            auto const budget_end = Clock::now() + policy.budget;
+            while (Clock::now() < budget_end) {
+                if (next == batch.size()) {
+                    batch.clear();
+                    next = 0;
+                    if (Terminal::event_queue.drain(batch) == 0) { break; }
+                }
+                if (auto const code = handle_next()) { return *code; }
+            }
+        }
+
+        if (!needs_paint) { continue; }
+
+        // Events left over from an exhausted budget are handled after this paint.
+        if (policy.max_frame_rate > 0 && next == batch.size()) {
+            auto const due = last_paint + std::chrono::duration_cast<Clock::duration>(
+                                              std::chrono::duration<double>{
+                                                  1. / policy.max_frame_rate});
+            // Handles events until the frame is due, even if they never stop coming.
+            while (Clock::now() < due) {
+                if (next == batch.size()) {
+                    batch.clear();
+                    next = 0;
+                    auto event = Terminal::event_queue.try_pop_until(due);
+                    if (!event.has_value()) { break; }
+                    batch.push_back(std::move(*event));
+                }
+                if (auto const code = handle_next()) { return *code; }
+                if (auto const code = tick_frame()) { return *code; }
+            }
+        }
+
+        if constexpr (HandlesPaint<EventHandler>) {
+            term.cursor = handler.handle_paint(Canvas{
+                .buffer = term.changes,
+                .at = {0, 0},
+                .size = term.changes.size(),
+            });
+        }
+        term.commit_changes();
+        needs_paint = false;
+        last_paint = Clock::now();
     }
 }
 
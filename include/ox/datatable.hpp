@@ -71,9 +71,9 @@ class DataTable : public Widget {
 
     void resize(Area) override;
 
-    auto get_children() -> zzz::Generator<Widget&> override;
+    void for_each_child(FunctionRef<void(Widget&)> fn) override;
 
-    auto get_children() const -> zzz::Generator<Widget const&> override;
+    void for_each_child(FunctionRef<void(Widget const&)> fn) const override;
 
    private:
     Row<std::vector<Label>> headings_;
@@ -6,13 +6,12 @@
 #include <cstddef>
 #include <memory>
 #include <numeric>
+#include <optional>
 #include <ranges>
 #include <tuple>
 #include <type_traits>
 #include <vector>
 
-#include <zzz/coro.hpp>
-
 #include <ox/bordered.hpp>
 #include <ox/core/core.hpp>
 #include <ox/widget.hpp>
@@ -23,26 +22,16 @@ namespace ox::detail {
  * Calculate the length of each Widget in the given total length based on the its
  * SizePolicy and the total space available.
  *
- * @param widgets The widgets to distribute the space between.
+ * @param size_policies The SizePolicy of each active Widget to distribute between.
  * @param total_length The total space to distribute.
  * @return A vector of the lengths of each child.
  */
-template <InputRangeOf<Widget> WidgetRange>
 [[nodiscard]]
-auto distribute_length(WidgetRange&& widgets, int total_length) -> std::vector<int>
+inline auto distribute_length(std::vector<SizePolicy> const& size_policies,
+                              int total_length) -> std::vector<int>
 {
     assert(total_length >= 0);
 
-    // Materialize the range because it can only be iterated once.
-    // I'd like to use ranges filter + transform + to<vector> but must wait for C++23.
-    auto const size_policies = [&] {
-        auto result = std::vector<SizePolicy>{};
-        for (auto const& w : widgets) {
-            if (w.active) { result.push_back(w.size_policy); }
-        }
-        return result;
-    }();
-
     if (total_length == 0) { return std::vector<int>(size_policies.size(), 0); }
 
     for ([[maybe_unused]] auto const& policy : size_policies) {
@@ -138,6 +127,72 @@ auto distribute_length(WidgetRange&& widgets, int total_length) -> std::vector<i
     return results;
 }
 
+/**
+ * Returns the SizePolicy of each active child of \p w, in order.
+ */
+[[nodiscard]]
+inline auto active_size_policies(Widget const& w) -> std::vector<SizePolicy>
+{
+    auto result = std::vector<SizePolicy>{};
+    w.for_each_child([&](Widget const& child) {
+        if (child.active) { result.push_back(child.size_policy); }
+    });
+    return result;
+}
+
+/**
+ * The starting offsets of a linear layout's active children along its axis.
+ *
+ * @details Rebuilt by the layout on each resize, so the child at a point can be found
+ * with a binary search instead of visiting every child.
+ */
+class LinearHitIndex {
+   public:
+    void clear()
+    {
+        begins_.clear();
+        indices_.clear();
+    }
+
+    /// Appends the child at \p index in the container, which starts at \p begin.
+    void add(int begin, std::size_t index)
+    {
+        begins_.push_back(begin);
+        indices_.push_back(index);
+    }
+
+    /// Returns the container index of the last child that starts at or before \p at.
+    [[nodiscard]] auto find(int at) const -> std::optional<std::size_t>
+    {
+        auto const upper = std::ranges::upper_bound(begins_, at);
+        if (upper == std::begin(begins_)) { return std::nullopt; }
+        return indices_[(std::size_t)(upper - std::begin(begins_) - 1)];
+    }
+
+   private:
+    std::vector<int> begins_;  // Sorted, one per active child.
+    std::vector<std::size_t> indices_;
+};
+
+/**
+ * Returns the child of \p children at \p index from \p hits that contains \p p.
+ *
+ * @details Returns nullptr if there is no such child, or if the index is out of date.
+ * @param at The offset of \p p along the layout's axis.
+ */
+template <typename Container>
+[[nodiscard]] auto find_child(Container& children,
+                              LinearHitIndex const& hits,
+                              int at,
+                              Point p) -> Widget*
+{
+    auto const index = hits.find(at);
+    if (!index.has_value() || *index >= std::ranges::size(children)) { return nullptr; }
+    Widget& child =
+        *std::ranges::next(std::ranges::begin(children), (std::ptrdiff_t)*index);
+    return child.active && contains(child, p) ? &child : nullptr;
+}
+
 }  // namespace ox::detail
 
 namespace ox {
@@ -189,64 +244,66 @@ class Column : public Widget {
     {}
 
    public:
-    auto get_children() -> zzz::Generator<Widget&> override
+    void for_each_child(FunctionRef<void(Widget&)> fn) override
     {
         if constexpr (TupleLike<Container>) {
-            // Re-emitting values from apply so that this scope is a coroutine
-            for (auto& w : std::apply(
-                     [](auto&... child) -> zzz::Generator<Widget&> {
-                         (co_yield child, ...);
-                     },
-                     children)) {
-                co_yield w;
-            }
+            std::apply([&](auto&... child) { (fn(child), ...); }, children);
         }
         else {
             for (Widget& child : children) {
-                co_yield child;
+                fn(child);
             }
         }
     }
 
-    auto get_children() const -> zzz::Generator<Widget const&> override
+    void for_each_child(FunctionRef<void(Widget const&)> fn) const override
     {
         if constexpr (TupleLike<Container>) {
-            // Re-emitting values from apply so that this scope is a coroutine
-            for (auto const& w : std::apply(
-                     [](auto const&... child) -> zzz::Generator<Widget const&> {
-                         (co_yield child, ...);
-                     },
-                     children)) {
-                co_yield w;
-            }
+            std::apply([&](auto const&... child) { (fn(child), ...); }, children);
         }
         else {
-            for (auto const& child : children) {
-                co_yield child;
+            for (Widget const& child : children) {
+                fn(child);
             }
         }
     }
 
     void resize(Area) override
     {
-        // TODO distribute_length filters out active children, can you do that in this
-        // scope instead?
-        auto const heights =
-            detail::distribute_length(this->get_children(), this->size.height);
-
-        auto active_children = this->get_children() | filter::is_active;
+        auto const heights = detail::distribute_length(
+            detail::active_size_policies(*this), this->size.height);
 
+        hit_index_.clear();
         auto y = 0;
         auto i = 0;
-        for (auto& child : active_children) {
-            child.at = {0, y};
-            auto const old_size = child.size;
-            child.size = {this->size.width, heights[i]};
-            child.resize(old_size);
-            y += heights[i];
-            ++i;
+        auto index = std::size_t{0};
+        this->for_each_child([&](Widget& child) {
+            if (child.active) {
+                child.at = {0, y};
+                auto const old_size = child.size;
+                child.size = {this->size.width, heights[i]};
+                child.resize(old_size);
+                hit_index_.add(y, index);
+                y += heights[i];
+                ++i;
+            }
+            ++index;
+        });
+        this->update();
+    }
+
+    auto child_at(Point p) -> Widget* override
+    {
+        if constexpr (std::ranges::random_access_range<Container>) {
+            if (auto* const child = detail::find_child(children, hit_index_, p.y, p)) {
+                return child;
+            }
         }
+        return this->Widget::child_at(p);
     }
+
+   private:
+    detail::LinearHitIndex hit_index_;
 };
 
 template <LayoutContainer Container>
@@ -286,64 +343,66 @@ class Row : public Widget {
     {}
 
    public:
-    auto get_children() -> zzz::Generator<Widget&> override
+    void for_each_child(FunctionRef<void(Widget&)> fn) override
     {
         if constexpr (TupleLike<Container>) {
-            // Re-emitting values from apply so that this scope is a coroutine
-            for (auto& w : std::apply(
-                     [](auto&... child) -> zzz::Generator<Widget&> {
-                         (co_yield child, ...);
-                     },
-                     children)) {
-                co_yield w;
-            }
+            std::apply([&](auto&... child) { (fn(child), ...); }, children);
         }
         else {
             for (Widget& child : children) {
-                co_yield child;
+                fn(child);
             }
         }
     }
 
-    auto get_children() const -> zzz::Generator<Widget const&> override
+    void for_each_child(FunctionRef<void(Widget const&)> fn) const override
     {
         if constexpr (TupleLike<Container>) {
-            // Re-emitting values from apply so that this scope is a coroutine
-            for (auto const& w : std::apply(
-                     [](auto const&... child) -> zzz::Generator<Widget const&> {
-                         (co_yield child, ...);
-                     },
-                     children)) {
-                co_yield w;
-            }
+            std::apply([&](auto const&... child) { (fn(child), ...); }, children);
         }
         else {
-            for (auto const& child : children) {
-                co_yield child;
+            for (Widget const& child : children) {
+                fn(child);
             }
         }
     }
 
     void resize(Area) override
     {
-        // TODO distribute_length filters out active children, can you do that in this
-        // scope instead?
-        auto const widths =
-            detail::distribute_length(this->get_children(), this->size.width);
-
-        auto active_children = this->get_children() | filter::is_active;
+        auto const widths = detail::distribute_length(
+            detail::active_size_policies(*this), this->size.width);
 
+        hit_index_.clear();
         auto x = 0;
         auto i = std::size_t{0};
-        for (auto& child : active_children) {
-            child.at = {.x = x, .y = 0};
-            auto const old_size = child.size;
-            child.size = {.width = widths[i], .height = this->size.height};
-            child.resize(old_size);
-            x += widths[i];
-            ++i;
+        auto index = std::size_t{0};
+        this->for_each_child([&](Widget& child) {
+            if (child.active) {
+                child.at = {.x = x, .y = 0};
+                auto const old_size = child.size;
+                child.size = {.width = widths[i], .height = this->size.height};
+                child.resize(old_size);
+                hit_index_.add(x, index);
+                x += widths[i];
+                ++i;
+            }
+            ++index;
+        });
+        this->update();
+    }
+
+    auto child_at(Point p) -> Widget* override
+    {
+        if constexpr (std::ranges::random_access_range<Container>) {
+            if (auto* const child = detail::find_child(children, hit_index_, p.x, p)) {
+                return child;
+            }
         }
+        return this->Widget::child_at(p);
     }
+
+   private:
+    detail::LinearHitIndex hit_index_;
 };
 
 template <LayoutContainer Container>
@@ -417,13 +476,14 @@ class Suspended : public Widget {
         };
 
         child.resize(old_size);
+        this->update();
     }
 
-    auto get_children() -> zzz::Generator<Widget&> override { co_yield child; }
+    void for_each_child(FunctionRef<void(Widget&)> fn) override { fn(child); }
 
-    auto get_children() const -> zzz::Generator<Widget const&> override
+    void for_each_child(FunctionRef<void(Widget const&)> fn) const override
     {
-        co_yield child;
+        fn(child);
     }
 };
 
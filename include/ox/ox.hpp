@@ -3,6 +3,7 @@
 #include <signals_light/signal.hpp>
 
 #include <ox/align.hpp>
+#include <ox/animation.hpp>
 #include <ox/application.hpp>
 #include <ox/bordered.hpp>
 #include <ox/button.hpp>
@@ -16,6 +17,8 @@
 #include <ox/put.hpp>
 #include <ox/radiogroup.hpp>
 #include <ox/scrollbar.hpp>
+#include <ox/task.hpp>
 #include <ox/textbox.hpp>
+#include <ox/thread_pool.hpp>
 #include <ox/timer.hpp>
 #include <ox/widget.hpp>
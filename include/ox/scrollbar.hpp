@@ -2,8 +2,8 @@
 
 #include <chrono>
 
+#include <ox/animation.hpp>
 #include <ox/core/core.hpp>
-#include <ox/timer.hpp>
 #include <ox/widget.hpp>
 
 namespace ox {
@@ -37,15 +37,14 @@ class ScrollBar : public Widget {
 
     void mouse_wheel(Mouse m) override;
 
-    void timer() override;
+    void animate(std::chrono::nanoseconds dt) override;
 
    private:
     void increment_position(int amount = 1);
 
    private:
-    using ClockType = std::chrono::steady_clock;
-    Timer timer_{*this, std::chrono::milliseconds{16}};
-    ClockType::time_point time_at_click_;
+    Animation animation_{*this};
+    std::chrono::nanoseconds since_click_{0};
     int position_at_click_ = 0;
     int target_position_ = 0;
 };
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include <ox/animation.hpp>
+#include <ox/application.hpp>
+#include <ox/core/core.hpp>
+#include <ox/thread_pool.hpp>
+#include <ox/timer.hpp>
+
+namespace ox::detail {
+
+struct SleepAwaiter {
+    std::chrono::milliseconds duration;
+
+    [[nodiscard]] auto await_ready() const -> bool { return duration.count() <= 0; }
+
+    void await_suspend(std::coroutine_handle<> h) const { resume_after(duration, h); }
+
+    void await_resume() const {}
+};
+
+struct FrameAwaiter {
+    Animation::Clock::time_point suspended_at = {};
+
+    [[nodiscard]] auto await_ready() const -> bool { return false; }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        suspended_at = Animation::Clock::now();
+        resume_on_next_frame(h);
+    }
+
+    [[nodiscard]] auto await_resume() const -> std::chrono::nanoseconds
+    {
+        return Animation::Clock::now() - suspended_at;
+    }
+};
+
+struct ReadableAwaiter {
+    int fd;
+
+    [[nodiscard]] auto await_ready() const -> bool { return false; }
+
+    void await_suspend(std::coroutine_handle<> h) const { resume_when_readable(fd, h); }
+
+    void await_resume() const {}
+};
+
+template <typename Fn>
+class PoolAwaiter : public PoolJob {
+   public:
+    using Result = std::invoke_result_t<Fn&>;
+
+   public:
+    explicit PoolAwaiter(Fn fn) : fn_{std::move(fn)} {}
+
+   public:
+    [[nodiscard]] auto await_ready() const -> bool { return false; }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        handle_ = h;
+        Application::thread_pool().push(*this);
+    }
+
+    auto await_resume() -> Result
+    {
+        if (error_) { std::rethrow_exception(error_); }
+        if constexpr (!std::is_void_v<Result>) { return std::move(*result_); }
+    }
+
+    /// Called on the worker thread, this object may be destroyed once it has posted.
+    void run() override
+    {
+        try {
+            if constexpr (std::is_void_v<Result>) { std::invoke(fn_); }
+            else {
+                result_.emplace(std::invoke(fn_));
+            }
+        }
+        catch (...) {
+            error_ = std::current_exception();
+        }
+        Terminal::event_queue.enqueue(event::Resume{handle_});
+    }
+
+   private:
+    Fn fn_;
+    std::coroutine_handle<> handle_;
+    std::conditional_t<std::is_void_v<Result>, bool, std::optional<Result>> result_;
+    std::exception_ptr error_;
+};
+
+}  // namespace ox::detail
+
+namespace ox {
+
+/**
+ * Return type for coroutines that run on the event loop thread.
+ *
+ * @details A Task starts running as soon as it is called and owns itself, its frame is
+ * destroyed when the coroutine finishes, so the returned Task can be discarded. At each
+ * `co_await` of the awaitables below the coroutine is suspended and later resumed from
+ * `process_events()` with an `event::Resume`, and painting follows as with any other
+ * Event. An exception that escapes the coroutine is passed to `exception_handler` and
+ * the frame is destroyed, see below.
+ *
+ * A Task that refers to a Widget must not outlive it, check a `LifetimeView` after each
+ * `co_await` if the Widget may be destroyed meanwhile. A lambda coroutine's captures
+ * live in the closure, not the coroutine frame, so the closure must outlive the Task.
+ */
+class Task {
+   public:
+    struct promise_type {
+        auto get_return_object() -> Task { return {}; }
+
+        auto initial_suspend() -> std::suspend_never { return {}; }
+
+        auto final_suspend() noexcept -> std::suspend_never { return {}; }
+
+        void return_void() {}
+
+        void unhandled_exception() noexcept
+        {
+            if (exception_handler) { exception_handler(std::current_exception()); }
+            else {
+                std::terminate();
+            }
+        }
+    };
+
+    /**
+     * Called with any exception that escapes a Task, on the thread that was running it.
+     *
+     * @details The exception does not propagate to whoever resumed the Task, which is
+     * usually `process_events()`, and the coroutine frame is destroyed after this
+     * returns. If this is empty, std::terminate() is called instead. This must not
+     * throw, std::terminate() is called if it does.
+     *
+     * Exceptions thrown by the work given to `Application::submit()` are also passed
+     * here, on the event loop thread.
+     */
+    inline static std::function<void(std::exception_ptr)> exception_handler = nullptr;
+};
+
+/**
+ * Suspends the Task for at least \p duration.
+ * @details Uses the timer thread shared by all Timers, millisecond resolution.
+ */
+[[nodiscard]] inline auto sleep(std::chrono::milliseconds duration)
+    -> detail::SleepAwaiter
+{
+    return {duration};
+}
+
+/**
+ * Suspends the Task until the next frame, where it is resumed before painting.
+ * @details `co_await` returns the time spent waiting. Keeps the frame clock running
+ * only while something waits on it, see Animation.
+ */
+[[nodiscard]] inline auto next_frame() -> detail::FrameAwaiter { return {}; }
+
+/**
+ * Suspends the Task until \p fd is readable, polled by the Terminal input thread.
+ */
+[[nodiscard]] inline auto readable(int fd) -> detail::ReadableAwaiter { return {fd}; }
+
+/**
+ * Runs \p fn on `Application::thread_pool()`, the Task is resumed on the event loop
+ * thread with its result.
+ * @details `co_await` returns the value returned by \p fn, or rethrows its exception.
+ */
+template <typename Fn>
+[[nodiscard]] auto run_in_pool(Fn fn) -> detail::PoolAwaiter<Fn>
+{
+    return detail::PoolAwaiter<Fn>{std::move(fn)};
+}
+
+}  // namespace ox
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace ox::detail {
+
+/**
+ * A unit of work for the ThreadPool.
+ *
+ * @details Jobs are owned by the caller, so queueing one does not allocate. The pool
+ * does not touch a job after calling `run()` or `cancel()`, it may delete itself from
+ * either.
+ */
+class PoolJob {
+   public:
+    virtual void run() = 0;
+
+    /// Called instead of `run()` if the pool is destroyed while this job is queued.
+    virtual void cancel() {}
+
+   protected:
+    ~PoolJob() = default;
+};
+
+}  // namespace ox::detail
+
+namespace ox {
+
+/**
+ * Work-stealing thread pool.
+ *
+ * @details Each worker has its own deque of jobs. A worker takes the newest job from
+ * its own deque and, when that is empty, steals the oldest job from another worker's.
+ * Jobs pushed from a worker go to its own deque, jobs pushed from other threads are
+ * spread across the workers in turn. Idle workers sleep until a job is pushed.
+ *
+ * Jobs still queued when the pool is destroyed are not run, they are cancelled.
+ */
+class ThreadPool {
+   public:
+    /**
+     * Starts \p thread_count worker threads, by default one per hardware thread and
+     * at least two.
+     */
+    explicit ThreadPool(std::size_t thread_count = default_thread_count());
+
+    ThreadPool(ThreadPool const&) = delete;
+    auto operator=(ThreadPool const&) -> ThreadPool& = delete;
+
+    /**
+     * Stops and joins the worker threads, after each finishes its current job.
+     * @details Then calls `cancel()` on every job that is still queued.
+     */
+    ~ThreadPool();
+
+   public:
+    /**
+     * Queues \p job to be run on a worker thread. \p job must stay alive until run.
+     */
+    void push(detail::PoolJob& job);
+
+    [[nodiscard]] auto thread_count() const -> std::size_t { return threads_.size(); }
+
+    [[nodiscard]] static auto default_thread_count() -> std::size_t;
+
+   private:
+    struct Worker {
+        std::mutex mtx;
+        std::deque<detail::PoolJob*> jobs;  // Guarded by mtx.
+    };
+
+   private:
+    void run(std::size_t index, std::stop_token st);
+
+    /// Pops the back of worker \p index's deque, else steals the front of another's.
+    [[nodiscard]] auto take(std::size_t index) -> detail::PoolJob*;
+
+   private:
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<std::size_t> next_worker_ = 0;  // Round robin for outside pushes.
+    std::atomic<std::size_t> queued_ = 0;       // Jobs in all deques.
+    std::mutex sleep_mtx_;
+    std::condition_variable_any job_ready_;
+    std::vector<std::jthread> threads_;  // Last, so it is joined first.
+};
+
+}  // namespace ox
@@ -1,9 +1,31 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <coroutine>
+#include <cstdint>
 #include <map>
+#include <memory>
 
-#include <zzz/timer_thread.hpp>
+namespace ox::detail {
+
+/**
+ * Shared by a Timer, the timer thread and the Application so that at most one
+ * `event::Timer` per Timer is waiting in the EventQueue.
+ */
+struct TimerState {
+    std::atomic<bool> pending = false;  // An event::Timer is in the EventQueue.
+    std::atomic<int> missed = 0;        // Ticks dropped while an event was pending.
+    int last_missed = 0;                // `missed` when the current event was handled.
+    std::atomic<std::uint64_t> generation = 0;  // Bumped by start() and stop().
+};
+
+/**
+ * Posts `event::Resume{h}` after \p delay, from the thread shared by all Timers.
+ */
+void resume_after(std::chrono::milliseconds delay, std::coroutine_handle<> h);
+
+}  // namespace ox::detail
 
 namespace ox {
 class Widget;
@@ -11,15 +33,20 @@ class Widget;
 /**
  * Posts `event::Timer` objects at regular intervals to the EventQueue.
  *
- * @details This uses its own internal thread to enqueue Events. Each Timer is tied to a
- * single Widget, which will recieve the Events. Timer events are handled with the
- * `Widget::timer()` virtual function, typically you would update the Widget state, the
- * `Widget::paint(Canvas)` event handler will be called automatically after the timer
- * event handler.
+ * @details All Timers share a single internal thread, a timing wheel with millisecond
+ * resolution, that enqueues the Events. Each Timer is tied to a single Widget, which
+ * will recieve the Events. Timer events are handled with the `Widget::timer()` virtual
+ * function, typically you would update the Widget state, the `Widget::paint(Canvas)`
+ * event handler will be called automatically after the timer event handler.
  *
  * The Widget lifetime is handled by a `LifetimeView` and will remain valid after moving
  * a Widget. Though not recommended for clarity, it is safe to delete a Widget without
  * deleting its associated Timer.
+ *
+ * If the previous event has not been handled when the Timer fires, for instance
+ * because painting takes longer than the interval, no new event is posted. The dropped
+ * ticks are counted and reported by `missed_ticks()` when the pending event is handled,
+ * so the EventQueue can't build up a backlog of Timer events.
  */
 class Timer {
    public:
@@ -28,7 +55,7 @@ class Timer {
      *
      * @param w The Widget to send Timer events to, typically `*this` if owned by Widg.
      * @param duration The interval to wait before posting an Event.
-     * @param launch If true, the TimerThread will be started immediately.
+     * @param launch If true, the Timer will be started immediately.
      */
     explicit Timer(Widget& w, std::chrono::milliseconds duration, bool launch = false);
 
@@ -39,20 +66,21 @@ class Timer {
     auto operator=(Timer&& other) -> Timer&;
 
     /**
-     * Stop the TimerThread if it is running.
+     * Stop the Timer if it is running.
      */
     ~Timer();
 
    public:
     /**
-     * Start the timer thread with the given duration.
-     * @details This will create and launch a new thread.
+     * Start posting Timer events at the given duration.
+     * @details Registers with the shared timer thread, no thread is created per Timer.
+     * Calling start() on a running Timer restarts its interval.
      */
     void start();
 
     /**
-     * Request the TimerThread to stop, returns immediately.
-     * @details Does not wait for thread to exit.
+     * Stop posting Timer events, returns immediately.
+     * @details An event already in the EventQueue will still be delivered.
      */
     void stop();
 
@@ -69,13 +97,21 @@ class Timer {
      */
     [[nodiscard]] auto is_running() const -> bool { return is_running_; }
 
+    /**
+     * Returns the number of ticks that were dropped before the Timer event currently
+     * being handled, because that event was still waiting in the EventQueue.
+     * @details Zero if the Widget is keeping up with the Timer. A handler can advance
+     * by `1 + missed_ticks()` steps to catch up at once.
+     */
+    [[nodiscard]] auto missed_ticks() const -> int { return state_->last_missed; }
+
    private:
     inline static int next_id_ = 0;
 
     int id_;
     std::chrono::milliseconds duration_;
-    zzz::TimerThread timer_thread_;
     bool is_running_ = false;
+    std::shared_ptr<detail::TimerState> state_ = std::make_shared<detail::TimerState>();
 };
 
 }  // namespace ox
\ No newline at end of file
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <ranges>
 #include <type_traits>
+#include <vector>
 
 #include <zzz/coro.hpp>
 
@@ -98,6 +103,19 @@ class Widget {
     Terminal::Cursor cursor = std::nullopt;
     bool active = true;
 
+    /**
+     * Keep the output of `paint()` in an offscreen layer and copy it to the screen
+     * instead of painting, until the Widget is updated or resized.
+     *
+     * @details For Widgets that are expensive to paint and rarely change. `update()`
+     * must be called after any change to what `paint()` would draw. The layer only
+     * holds what `paint()` writes, down to the symbol, colors and traits of each cell,
+     * so the rest of the Canvas shows through as if painted directly. `paint()` must
+     * not read the Canvas. It is called twice to fill the layer unless it writes whole
+     * Glyphs.
+     */
+    bool cache_paint = false;
+
     Point at = {.x = 0, .y = 0};
     Area size = {.width = 0, .height = 0};
     std::shared_ptr<Widget*> lifetime = std::make_shared<Widget*>(this);
@@ -142,11 +160,106 @@ class Widget {
 
     virtual void timer() {}
 
+    /**
+     * Called once per frame while an associated `Animation` is running. \p dt is the
+     * time elapsed since the previous call, or since the Animation was started.
+     */
+    virtual void animate(std::chrono::nanoseconds /* dt */) {}
+
     virtual void paint(Canvas) {}
 
-    virtual auto get_children() -> zzz::Generator<Widget&> { co_return; }
+    /**
+     * Calls \p fn with each child of this Widget, in order.
+     *
+     * @details Layout types that own child Widgets override both overloads. This is how
+     * the Application and the layouts walk the Widget tree, so it must not allocate.
+     */
+    virtual void for_each_child(FunctionRef<void(Widget&)> /* fn */) {}
+
+    virtual void for_each_child(FunctionRef<void(Widget const&)> /* fn */) const {}
+
+    /**
+     * Returns a generator over each child of this Widget, for use in range-for loops.
+     *
+     * @details A convenience built on `for_each_child()`, this allocates on each call.
+     */
+    auto get_children() -> zzz::Generator<Widget&>;
+
+    auto get_children() const -> zzz::Generator<Widget const&>;
+
+    /**
+     * Returns the first active child that contains \p p, or nullptr if there is none.
+     *
+     * @details \p p is relative to this Widget. The default searches the children in
+     * order, layouts override this with a faster lookup. Used by the Application to
+     * dispatch mouse events.
+     */
+    [[nodiscard]] virtual auto child_at(Point p) -> Widget*;
+
+   public:
+    /**
+     * Marks this Widget, and its children, to be repainted on the next frame.
+     *
+     * @details Only has an effect with Terminal::PaintPolicy::retained, where Widgets
+     * that have not been updated keep their cells from the previous frame. A Widget is
+     * updated when it is sent a key, mouse press, release or wheel event, when it gains
+     * or loses focus and on each Animation frame. The library Widgets update themselves
+     * when their state is changed through member functions. Call this after changing a
+     * Widget from anywhere else, such as assigning to its public members, or after
+     * changing the `active` flag, position or size of its children.
+     */
+    void update() { last_update_ = next_update(); }
+
+    /// Returns the value of `update_count()` from when this Widget was last updated.
+    [[nodiscard]] auto last_update() const -> std::uint64_t { return last_update_; }
+
+    /**
+     * Returns the number of `update()` calls made on all Widgets.
+     *
+     * @details The count is atomic, so Widgets can be constructed and updated on other
+     * threads, such as in work passed to `Application::submit()`.
+     */
+    [[nodiscard]] static auto update_count() -> std::uint64_t
+    {
+        return update_count_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Calls `paint(c)`, or with `cache_paint` copies the cached layer to \p c.
+     *
+     * @details The layer is painted again first if it is missing, if this Widget has
+     * been updated since or if the Canvas size has changed. Used by the Application.
+     */
+    void render(Canvas c);
+
+   private:
+    // The cells written by the last paint() into the offscreen layer, as runs of
+    // consecutive cells whose Glyphs are stored back to back in `glyphs`. `fields` has
+    // the Glyph fields that were written in each cell, only those are copied.
+    struct Layer {
+        struct Run {
+            Point at;
+            int length;
+        };
+
+        std::uint64_t update;  // last_update() when painted.
+        std::vector<Run> runs;
+        std::vector<Glyph> glyphs;
+        std::vector<std::uint8_t> fields;
+        ScreenBuffer scratch;  // Painted into, unwritten and undamaged between paints.
+    };
 
-    virtual auto get_children() const -> zzz::Generator<Widget const&> { co_return; }
+   private:
+    /// Increments `update_count_` and returns the new value.
+    [[nodiscard]] static auto next_update() -> std::uint64_t
+    {
+        return update_count_.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+   private:
+    std::optional<Layer> layer_;
+    std::uint64_t last_update_ = next_update();  // New Widgets need a first paint.
+    inline static std::atomic<std::uint64_t> update_count_ = 0;
 };
 
 /**
@@ -209,6 +322,19 @@ inline constexpr auto is_active =
 
 }  // namespace filter
 
+namespace detail {
+
+/**
+ * Returns true if \p p is within \p w, \p p is relative to the parent of \p w.
+ */
+[[nodiscard]] inline auto contains(Widget const& w, Point p) -> bool
+{
+    return w.at.x <= p.x && p.x < w.at.x + w.size.width && w.at.y <= p.y &&
+           p.y < w.at.y + w.size.height;
+}
+
+}  // namespace detail
+
 /**
  * Create a handle to the lifetime of the given Widget.
  *
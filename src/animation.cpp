@@ -0,0 +1,149 @@
+#include <ox/animation.hpp>
+
+#include <chrono>
+#include <coroutine>
+#include <map>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <ox/widget.hpp>
+
+namespace {
+
+using namespace ox;
+
+struct Target {
+    LifetimeView<Widget> widget;
+    std::optional<Animation::Clock::time_point> last_frame;  // Set while running.
+};
+
+/// Map of Animation id to its target Widget.
+auto targets = std::map<int, Target>{};
+
+/// Number of running Animations, the frame clock is stopped when this is zero.
+auto running_count = 0;
+
+/// Coroutines waiting for the next frame.
+auto frame_waiters = std::vector<std::coroutine_handle<>>{};
+
+/// Scratch buffers for tick(), kept between frames so a frame doesn't allocate.
+auto frame_ids = std::vector<int>{};
+auto resuming = std::vector<std::coroutine_handle<>>{};
+
+/// Time of the previous frame, or of the first start() since the clock was stopped.
+auto clock_origin = Animation::Clock::time_point{};
+
+[[nodiscard]] auto clock_is_running() -> bool
+{
+    return running_count > 0 || !frame_waiters.empty();
+}
+
+}  // namespace
+
+namespace ox {
+
+Animation::Animation(Widget& w, bool launch) : id_{next_id_++}
+{
+    targets.emplace(std::pair{id_, Target{.widget = track(w), .last_frame = {}}});
+    if (launch) { this->start(); }
+}
+
+Animation::Animation(Animation&& other)
+{
+    id_ = std::move(other.id_);
+    other.id_ = -1;
+    is_running_ = std::move(other.is_running_);
+    other.is_running_ = false;
+}
+
+auto Animation::operator=(Animation&& other) -> Animation&
+{
+    if (this != &other) {
+        if (this->is_running_) { this->stop(); }
+        targets.erase(id_);
+        id_ = std::move(other.id_);
+        other.id_ = -1;
+        is_running_ = std::move(other.is_running_);
+        other.is_running_ = false;
+    }
+    return *this;
+}
+
+Animation::~Animation()
+{
+    if (is_running_) { this->stop(); }
+    targets.erase(id_);
+}
+
+void Animation::start()
+{
+    if (is_running_) { return; }
+    auto const at = targets.find(id_);
+    if (at == std::end(targets)) { return; }
+
+    auto const now = Clock::now();
+    if (!clock_is_running()) { clock_origin = now; }
+    ++running_count;
+    at->second.last_frame = now;
+    is_running_ = true;
+}
+
+void Animation::stop()
+{
+    if (!is_running_) { return; }
+    if (auto const at = targets.find(id_); at != std::end(targets)) {
+        at->second.last_frame = std::nullopt;
+    }
+    --running_count;
+    is_running_ = false;
+}
+
+auto Animation::next_frame() -> std::optional<Clock::time_point>
+{
+    if (!clock_is_running()) { return std::nullopt; }
+    return clock_origin + frame_interval;
+}
+
+void Animation::tick(Clock::time_point now)
+{
+    clock_origin = now;
+
+    // Handlers may start, stop or destroy Animations, so look each one up again.
+    frame_ids.clear();
+    for (auto const& [id, target] : targets) {
+        if (target.last_frame.has_value()) { frame_ids.push_back(id); }
+    }
+
+    for (auto const id : frame_ids) {
+        auto const at = targets.find(id);
+        if (at == std::end(targets) || !at->second.last_frame.has_value()) { continue; }
+        auto& target = at->second;
+        auto const dt = now - *target.last_frame;
+        target.last_frame = now;
+        if (target.widget.valid()) {
+            auto& widget = target.widget.get();
+            widget.animate(std::chrono::duration_cast<std::chrono::nanoseconds>(dt));
+            widget.update();
+        }
+    }
+
+    // Coroutines that wait again are resumed on the following frame.
+    resuming.swap(frame_waiters);
+    for (auto const h : resuming) {
+        h.resume();
+    }
+    resuming.clear();
+}
+
+}  // namespace ox
+
+namespace ox::detail {
+
+void resume_on_next_frame(std::coroutine_handle<> h)
+{
+    if (!clock_is_running()) { clock_origin = Animation::Clock::now(); }
+    frame_waiters.push_back(h);
+}
+
+}  // namespace ox::detail
@@ -2,6 +2,8 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstdint>
+#include <exception>
 #include <ranges>
 #include <utility>
 
@@ -9,64 +11,18 @@
 
 #include <ox/core/core.hpp>
 #include <ox/focus.hpp>
+#include <ox/task.hpp>
 
 namespace {
 
 using namespace ox;
 
 /**
- * Find the Widget in \p widgets that contains the Point \p p.
- *
- * @details This does not check descendants of the Widgets in \p widgets. \p p is
- * relative to the parent of the passed in Widgets; the top left corner of the parent is
- * {0, 0}.
- * @param widgets The Widgets to search.
- * @param p The Point to search for.
- * @returns A pointer to the Widget that contains \p p, or nullptr if no Widget.
+ * Returns true if Tab and BackTab can move the focus to \p w.
  */
-template <InputRangeOf<Widget> R>
-[[nodiscard]] auto find_widget_at(R&& widgets, Point p) -> Widget*
+[[nodiscard]] auto is_tab_focusable(Widget const& w) -> bool
 {
-    auto const at = std::ranges::find_if(widgets, [p](Widget& child) {
-        return child.at.x <= p.x && p.x < child.at.x + child.size.width &&
-               child.at.y <= p.y && p.y < child.at.y + child.size.height;
-    });
-
-    return (at == std::end(widgets)) ? nullptr : &*at;
-}
-
-/**
- * Execute \p fn on \p w and every descendant of \p w, in a depth first traversal.
- *
- * @param w The Widget to start the traversal from.
- * @param fn The function to execute on each Widget.
- */
-void for_each_depth_first(Widget& w, std::function<void(Widget&)> const& fn)
-{
-    fn(w);
-    for (Widget& child : w.get_children()) {
-        for_each_depth_first(child, fn);
-    }
-}
-
-/**
- * Find the first Widget in \p w and its descendants that satisfies \p predicate.
- *
- * @details This includes \p w itself in the search.
- * @param w The Widget to start the search from.
- * @param predicate The function to test each Widget with.
- * @returns A pointer to the first Widget that satisfies \p predicate, or nullptr if no
- * Widget is found.
- */
-[[nodiscard]] auto find_if_depth_first(
-    Widget& w,
-    std::function<bool(Widget const&)> const& predicate) -> Widget*
-{
-    Widget* result = nullptr;
-    for_each_depth_first(w, [&](Widget& child) {
-        if (result == nullptr && predicate(child)) { result = &child; }
-    });
-    return result;
+    return w.focus_policy == FocusPolicy::Strong || w.focus_policy == FocusPolicy::Tab;
 }
 
 // -------------------------------------------------------------------------------------
@@ -76,8 +32,7 @@ enum class SetFocus : bool { Yes, No };
 template <SetFocus SF, typename EventFn>
 void any_mouse_event(Widget& head, Mouse m, EventFn&& event_fn)
 {
-    Widget* const found_ptr =
-        find_widget_at(head.get_children() | filter::is_active, m.at);
+    Widget* const found_ptr = head.child_at(m.at);
 
     if (found_ptr == nullptr) {  // `head` is last Widget that contains m.at
         if constexpr (SF == SetFocus::Yes) {
@@ -97,23 +52,21 @@ void any_mouse_event(Widget& head, Mouse m, EventFn&& event_fn)
 void send_leave_events(Widget& w, Point p)
 {
     w.mouse_leave();
-    Widget* const next = find_widget_at(w.get_children() | filter::is_active, p);
+    Widget* const next = w.child_at(p);
     if (next != nullptr) { send_leave_events(*next, p - next->at); }
 }
 
 void send_enter_events(Widget& w, Point p)
 {
     w.mouse_enter();
-    Widget* const next = find_widget_at(w.get_children() | filter::is_active, p);
+    Widget* const next = w.child_at(p);
     if (next != nullptr) { send_enter_events(*next, p - next->at); }
 }
 
 void send_enter_leave_events(Widget& w, Point previous, Point current)
 {
-    Widget* const previous_widget =
-        find_widget_at(w.get_children() | filter::is_active, previous);
-    Widget* const current_widget =
-        find_widget_at(w.get_children() | filter::is_active, current);
+    Widget* const previous_widget = w.child_at(previous);
+    Widget* const current_widget = w.child_at(current);
 
     if (previous_widget != nullptr && current_widget != nullptr &&
         previous != current) {
@@ -124,60 +77,12 @@ void send_enter_leave_events(Widget& w, Point previous, Point current)
 
 // -------------------------------------------------------------------------------------
 
-void do_tab_focus_change(Widget& head, Widget const& current_focus)
-{
-    Widget* next = find_if_depth_first(
-        head, [found = false, &current_focus](Widget const& w) mutable {
-            if (found) {
-                return w.focus_policy == FocusPolicy::Strong ||
-                       w.focus_policy == FocusPolicy::Tab;
-            }
-            else {
-                if (&w == &current_focus) { found = true; }
-                return false;
-            }
-        });
-
-    if (next == nullptr) {
-        next = find_if_depth_first(head, [](Widget const& w) {
-            return w.focus_policy == FocusPolicy::Strong ||
-                   w.focus_policy == FocusPolicy::Tab;
-        });
-    }
-
-    if (next != nullptr && next != &current_focus) { Focus::set(*next); }
-}
-
-void do_shift_tab_focus_change(Widget& head, Widget const& current_focus)
-{
-    Widget* next = nullptr;
-
-    for_each_depth_first(
-        head, [&next, previous = (Widget*)nullptr, &current_focus](Widget& w) mutable {
-            if (&w == &current_focus) { next = previous; }
-            if (w.focus_policy == FocusPolicy::Strong ||
-                w.focus_policy == FocusPolicy::Tab) {
-                previous = &w;
-            }
-        });
-
-    if (next == nullptr) {
-        for_each_depth_first(head, [&next](Widget& w) {
-            if (w.focus_policy == FocusPolicy::Strong ||
-                w.focus_policy == FocusPolicy::Tab) {
-                next = &w;
-            }
-        });
-    }
-
-    if (next != nullptr && next != &current_focus) { Focus::set(*next); }
-}
-
 // Recursively send paint events to each Widget including and below head. \p cursor is
 // assigned to if the current focus widget is painted.
 void send_paint_events(Widget& head, Canvas canvas, Terminal::Cursor& cursor_out)
 {
-    for (auto& child : head.get_children() | filter::is_active) {
+    head.for_each_child([&](Widget& child) {
+        if (!child.active) { return; }
         send_paint_events(child,
                           Canvas{
                               .buffer = canvas.buffer,
@@ -185,15 +90,62 @@ void send_paint_events(Widget& head, Canvas canvas, Terminal::Cursor& cursor_out
                               .size = child.size,
                           },
                           cursor_out);
-    }
+    });
     if (head.active && head.size.width > 0 && head.size.height > 0) {
-        head.paint(canvas);
+        head.render(canvas);
         if (auto const life = Focus::get(); life.valid() && &(life.get()) == &head) {
             cursor_out = head.cursor ? canvas.at + *head.cursor : head.cursor;
         }
     }
 }
 
+// Repaints each Widget including and below head that was updated after
+// \p painted_through, along with its descendants, over blank cells. The cells of every
+// other Widget are left as they are, apart from the ancestors of a repainted Widget,
+// which paint over it again as they would in send_paint_events. \p cursor_out is
+// assigned to when \p focused is reached. Returns true if anything was painted.
+auto send_update_paint_events(Widget& head,
+                              Canvas canvas,
+                              std::uint64_t painted_through,
+                              Widget const* focused,
+                              Terminal::Cursor& cursor_out) -> bool
+{
+    if (head.last_update() > painted_through) {
+        auto const buffer_size = canvas.buffer.size();
+        auto const width = std::min(canvas.size.width, buffer_size.width - canvas.at.x);
+        auto const height =
+            std::min(canvas.size.height, buffer_size.height - canvas.at.y);
+        for (auto y = 0; y < height; ++y) {
+            for (auto x = 0; x < width; ++x) {
+                canvas[{x, y}] = Glyph{};
+            }
+        }
+        send_paint_events(head, canvas, cursor_out);
+        return true;
+    }
+
+    auto painted = false;
+    head.for_each_child([&](Widget& child) {
+        if (!child.active) { return; }
+        auto const child_canvas = Canvas{
+            .buffer = canvas.buffer,
+            .at = canvas.at + child.at,
+            .size = child.size,
+        };
+        if (send_update_paint_events(child, child_canvas, painted_through, focused,
+                                     cursor_out)) {
+            painted = true;
+        }
+    });
+    if (head.active && head.size.width > 0 && head.size.height > 0) {
+        if (painted) { head.render(canvas); }
+        if (&head == focused) {
+            cursor_out = head.cursor ? canvas.at + *head.cursor : head.cursor;
+        }
+    }
+    return painted;
+}
+
 }  // namespace
 
 namespace ox {
@@ -212,22 +164,28 @@ void Application::quit(int code) { quit_request_ = code; }
 
 auto Application::handle_mouse_press(Mouse m) -> EventResponse
 {
-    ::any_mouse_event<SetFocus::Yes>(head_, m,
-                                     [](Widget& w, Mouse m) { w.mouse_press(m); });
+    ::any_mouse_event<SetFocus::Yes>(head_, m, [](Widget& w, Mouse m) {
+        w.update();
+        w.mouse_press(m);
+    });
     return quit_request_ ? QuitRequest{*quit_request_} : EventResponse{};
 }
 
 auto Application::handle_mouse_release(Mouse m) -> EventResponse
 {
-    ::any_mouse_event<SetFocus::No>(head_, m,
-                                    [](Widget& w, Mouse m) { w.mouse_release(m); });
+    ::any_mouse_event<SetFocus::No>(head_, m, [](Widget& w, Mouse m) {
+        w.update();
+        w.mouse_release(m);
+    });
     return quit_request_ ? QuitRequest{*quit_request_} : EventResponse{};
 }
 
 auto Application::handle_mouse_wheel(Mouse m) -> EventResponse
 {
-    ::any_mouse_event<SetFocus::No>(head_, m,
-                                    [](Widget& w, Mouse m) { w.mouse_wheel(m); });
+    ::any_mouse_event<SetFocus::No>(head_, m, [](Widget& w, Mouse m) {
+        w.update();
+        w.mouse_wheel(m);
+    });
     return quit_request_ ? QuitRequest{*quit_request_} : EventResponse{};
 }
 
@@ -248,12 +206,13 @@ auto Application::handle_key_press(Key k) -> EventResponse
     auto& focused = life.get();
     if (focused.focus_policy == FocusPolicy::Strong ||
         focused.focus_policy == FocusPolicy::Tab) {
-        if (k == Key::Tab) { do_tab_focus_change(head_, focused); }
-        else if (k == Key::BackTab) {
-            do_shift_tab_focus_change(head_, focused);
+        if (k == Key::Tab || k == Key::BackTab) {
+            auto* const next = focus_chain_.next(head_, focused, k == Key::Tab);
+            if (next != nullptr && next != &focused) { Focus::set(*next); }
         }
     }
 
+    focused.update();
     focused.key_press(k);
 
     return quit_request_ ? QuitRequest{*quit_request_} : EventResponse{};
@@ -261,7 +220,10 @@ auto Application::handle_key_press(Key k) -> EventResponse
 
 auto Application::handle_key_release(Key k) -> EventResponse
 {
-    if (auto const life = Focus::get(); life.valid()) { life.get().key_release(k); }
+    if (auto const life = Focus::get(); life.valid()) {
+        life.get().update();
+        life.get().key_release(k);
+    }
     return quit_request_ ? QuitRequest{*quit_request_} : EventResponse{};
 }
 
@@ -270,6 +232,7 @@ auto Application::handle_resize(Area new_size) -> EventResponse
     auto const old_size = head_.size;
     head_.size = new_size;
     head_.resize(old_size);
+    head_.update();  // The resized ScreenBuffer holds no previous frame.
     return quit_request_ ? QuitRequest{*quit_request_} : EventResponse{};
 }
 
@@ -279,18 +242,142 @@ auto Application::handle_timer(int id) -> EventResponse
     // the id to the Widget
     auto const at = timer_targets.find(id);
     if (at != std::cend(timer_targets)) {
-        if (at->second.valid()) { at->second.get().timer(); }
+        auto& [widget, state] = at->second;
+        // Cleared before the handler runs, so the next tick can post a new event.
+        if (state != nullptr) {
+            state->last_missed = state->missed.exchange(0);
+            state->pending = false;
+        }
+        if (widget.valid()) { widget.get().timer(); }
     }
     return quit_request_ ? QuitRequest{*quit_request_} : EventResponse{};
 }
 
+auto Application::next_frame() const -> std::optional<Animation::Clock::time_point>
+{
+    return Animation::next_frame();
+}
+
+auto Application::handle_frame(Animation::Clock::time_point now) -> EventResponse
+{
+    Animation::tick(now);
+    return quit_request_ ? QuitRequest{*quit_request_} : EventResponse{};
+}
+
 auto Application::handle_paint(Canvas canvas) -> Terminal::Cursor
 {
-    auto cursor = Terminal::Cursor{std::nullopt};
-    ::send_paint_events(head_, canvas, cursor);
-    return cursor;
+    if (!term_.paint_policy.retained) {
+        painted_through_ = 0;  // The next retained paint starts from blank cells.
+        auto cursor = Terminal::Cursor{std::nullopt};
+        ::send_paint_events(head_, canvas, cursor);
+        return cursor;
+    }
+
+    // Widgets can only have changed if one of them has been updated.
+    if (auto const count = Widget::update_count(); count != painted_through_) {
+        auto const life = Focus::get();
+        cursor_ = std::nullopt;
+        ::send_update_paint_events(head_, canvas, painted_through_,
+                                   life.valid() ? &life.get() : nullptr, cursor_);
+        painted_through_ = count;
+    }
+    return cursor_;
 }
 
 std::optional<int> Application::quit_request_ = std::nullopt;
 
-}  // namespace ox
\ No newline at end of file
+}  // namespace ox
+
+namespace ox::detail {
+
+void handle_submit_exception(std::exception_ptr error) noexcept
+{
+    if (Task::exception_handler) { Task::exception_handler(error); }
+    else {
+        std::terminate();
+    }
+}
+
+auto FocusChain::next(Widget& head, Widget const& current, bool forward) -> Widget*
+{
+    if (auto const found = this->find_next(head, current, forward)) { return *found; }
+    this->rebuild(head);
+    if (auto const found = this->find_next(head, current, forward)) { return *found; }
+
+    // The focused Widget is not in the tree, start from the first or last focusable.
+    auto const focusable = [](Entry const& e) { return ::is_tab_focusable(*e.widget); };
+    if (forward) {
+        auto const at = std::ranges::find_if(entries_, focusable);
+        return at == std::end(entries_) ? nullptr : at->widget;
+    }
+    auto const at = std::find_if(std::rbegin(entries_), std::rend(entries_), focusable);
+    return at == std::rend(entries_) ? nullptr : at->widget;
+}
+
+void FocusChain::rebuild(Widget& head)
+{
+    entries_.clear();
+    index_.clear();
+    this->append(head, 0);
+}
+
+void FocusChain::append(Widget& w, std::size_t parent)
+{
+    auto const at = entries_.size();
+    index_[&w] = at;
+    entries_.push_back({.widget = &w, .life = track(w), .parent = parent, .end = 0});
+    w.for_each_child([&](Widget& child) { this->append(child, at); });
+    entries_[at].end = entries_.size();
+}
+
+auto FocusChain::children_match(std::size_t at) const -> bool
+{
+    auto const& entry = entries_[at];
+    if (!entry.life.valid()) { return false; }
+
+    auto position = at + 1;
+    auto matches = true;
+    std::as_const(*entry.widget).for_each_child([&](Widget const& child) {
+        matches = matches && position < entry.end &&
+                  entries_[position].widget == &child &&
+                  entries_[position].life.valid();
+        if (matches) { position = entries_[position].end; }
+    });
+    return matches && position == entry.end;
+}
+
+auto FocusChain::ancestors_match(std::size_t at) const -> bool
+{
+    do {
+        at = entries_[at].parent;
+        if (!this->children_match(at)) { return false; }
+    } while (at != 0);
+    return true;
+}
+
+auto FocusChain::find_next(Widget const& head,
+                           Widget const& current,
+                           bool forward) const -> std::optional<Widget*>
+{
+    if (entries_.empty() || entries_.front().widget != &head) { return std::nullopt; }
+    auto const found = index_.find(&current);
+    if (found == std::cend(index_)) { return std::nullopt; }
+    auto const at = found->second;
+    if (!this->ancestors_match(at)) { return std::nullopt; }
+
+    // A Widget added between two entries is a child of an entry passed over, or of an
+    // ancestor of the first entry going forward, or of the last going backward.
+    auto const count = entries_.size();
+    auto const step = forward ? std::size_t{1} : count - 1;
+    if (forward && !this->children_match(at)) { return std::nullopt; }
+    for (auto i = (at + step) % count; i != at; i = (i + step) % count) {
+        if (!this->children_match(i)) { return std::nullopt; }
+        if (::is_tab_focusable(*entries_[i].widget)) {
+            if (!forward && !this->ancestors_match(i)) { return std::nullopt; }
+            return entries_[i].widget;
+        }
+    }
+    return entries_[at].widget;
+}
+
+}  // namespace ox::detail
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <ox/button.hpp>
 
 #include <algorithm>
+#include <chrono>
 #include <functional>
 #include <utility>
 #include <variant>
@@ -45,12 +46,7 @@ Button::Button(Options x)
                   [this](Fade f) -> DecorationInternal {
                       return {FadeInternal{
                           .fade = std::move(f),
-                          .timer =
-                              Timer{
-                                  *this,
-                                  std::chrono::milliseconds{timer_period_ms},
-                                  false,
-                              },
+                          .animation = Animation{*this},
                       }};
                   },
               },
@@ -108,15 +104,17 @@ void Button::mouse_enter() { this->start_select(); }
 
 void Button::mouse_leave() { this->end_select(); }
 
-void Button::timer()
+void Button::animate(std::chrono::nanoseconds dt)
 {
-    auto const update_fade = [](FadeInternal& f) {
-        auto const delta =
-            timer_period_ms / (float)(f.direction == +1 ? f.fade.fade_in.count()
-                                                        : f.fade.fade_out.count());
+    auto const update_fade = [dt](FadeInternal& f) {
+        auto const length = f.direction == +1 ? f.fade.fade_in : f.fade.fade_out;
+        auto const delta = length.count() > 0
+                               ? std::chrono::duration<float>{dt} /
+                                     std::chrono::duration<float>{length}
+                               : 1.f;
 
         f.percent = std::clamp(f.percent + delta * (float)f.direction, 0.f, 1.f);
-        if (f.percent == 0.f || f.percent == 1.f) { f.timer.stop(); }
+        if (f.percent == 0.f || f.percent == 1.f) { f.animation.stop(); }
     };
 
     std::visit(
@@ -133,7 +131,7 @@ void Button::start_select()
                    [](PaintFn const&) {},
                    [](FadeInternal& f) {
                        f.direction = +1;
-                       if (not f.timer.is_running()) { f.timer.start(); }
+                       f.animation.start();
                    },
                },
                decoration_);
@@ -145,7 +143,7 @@ void Button::end_select()
                    [](PaintFn const&) {},
                    [](FadeInternal& f) {
                        f.direction = -1;
-                       if (not f.timer.is_running()) { f.timer.start(); }
+                       f.animation.start();
                    },
                },
                decoration_);
@@ -14,6 +14,7 @@ CheckBox::CheckBox(Options x)
 
 void CheckBox::toggle()
 {
+    this->update();
     if (state_ == State::Checked) {
         state_ = State::UnChecked;
         this->on_uncheck();
@@ -28,6 +29,7 @@ void CheckBox::check()
 {
     if (state_ != State::Checked) {
         state_ = State::Checked;
+        this->update();
         this->on_check();
     }
 }
@@ -36,6 +38,7 @@ void CheckBox::uncheck()
 {
     if (state_ != State::UnChecked) {
         state_ = State::UnChecked;
+        this->update();
         this->on_uncheck();
     }
 }
@@ -44,6 +47,7 @@ void CheckBox::set_state(State s)
 {
     if (state_ != s) {
         state_ = s;
+        this->update();
         if (state_ == State::Checked) { this->on_check(); }
         else {
             this->on_uncheck();
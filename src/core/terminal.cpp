@@ -1,7 +1,35 @@
 #include <ox/core/terminal.hpp>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include <wchar.h>
 
 #include <esc/detail/signals.hpp>
 #include <esc/detail/transcode.hpp>
@@ -9,16 +37,530 @@
 #include <esc/sequence.hpp>
 #include <esc/terminal.hpp>
 
+namespace {
+using namespace ox;
+
+/**
+ * Replace TermColor::Default in \p g with the given default colors.
+ */
+[[nodiscard]] auto resolve(Glyph g, Color const& foreground, Color const& background)
+    -> Glyph
+{
+    if (g.brush.background == Color{TermColor::Default}) {
+        g.brush.background = background;
+    }
+    if (g.brush.foreground == Color{TermColor::Default}) {
+        g.brush.foreground = foreground;
+    }
+    return g;
+}
+
+/**
+ * FNV-1a hash of the object representation of \p x, skipped if it has padding bits.
+ */
+template <typename T>
+void hash_append(std::uint64_t& hash, T const& x)
+{
+    if constexpr (std::has_unique_object_representations_v<T>) {
+        for (auto const byte : std::bit_cast<std::array<unsigned char, sizeof(T)>>(x)) {
+            hash ^= byte;
+            hash *= 0x100000001b3;
+        }
+    }
+}
+
+void hash_append(std::uint64_t& hash, Color const& c)
+{
+    hash_append(hash, c.index());
+    std::visit([&hash](auto const& value) { hash_append(hash, value); }, c);
+}
+
+void hash_append(std::uint64_t& hash, Glyph const& g)
+{
+    hash_append(hash, g.symbol);
+    hash_append(hash, g.brush.background);
+    hash_append(hash, g.brush.foreground);
+    hash_append(hash, g.brush.traits);
+}
+
+/**
+ * Hash row \p y of \p buffer, after resolving default colors.
+ */
+[[nodiscard]] auto row_hash(ScreenBuffer const& buffer,
+                            int y,
+                            Color const& foreground,
+                            Color const& background) -> std::uint64_t
+{
+    auto hash = std::uint64_t{0xcbf29ce484222325};
+    for (auto x = 0; x < buffer.size().width; ++x) {
+        hash_append(hash, resolve(buffer[{x, y}], foreground, background));
+    }
+    return hash;
+}
+
+/**
+ * A block of rows [top, bottom] that has moved by `distance` rows, +up/-down.
+ */
+struct Scroll {
+    int top;
+    int bottom;
+    int distance;
+};
+
+/**
+ * Find the single vertical shift of rows that saves the most redrawn rows.
+ *
+ * @details A row is saved if it differs from the current row at its position but is
+ * equal to the current row `distance` rows away. Rows exposed by the shift count
+ * against it, since they have to be redrawn. Collisions only cost output size, the
+ * cell diff corrects any mismatch.
+ * @param next The row hashes of the next screen.
+ * @param current The row hashes of the current screen.
+ * @returns The Scroll to perform, or std::nullopt if no shift is worth performing.
+ */
+[[nodiscard]] auto find_scroll(std::vector<std::uint64_t> const& next,
+                               std::vector<std::uint64_t> const& current)
+    -> std::optional<Scroll>
+{
+    constexpr auto minimum_saved = 2;
+
+    auto const height = (int)next.size();
+    auto result = std::optional<Scroll>{};
+    auto best = minimum_saved - 1;
+
+    for (auto distance = 1 - height; distance < height; ++distance) {
+        if (distance == 0) { continue; }
+        auto const first = std::max(0, -distance);
+        auto const last = std::min(height, height - distance);  // one past
+
+        auto run_begin = first;
+        auto saved = 0;
+        for (auto y = first; y <= last; ++y) {
+            auto const match = y < last && next[(std::size_t)y] ==
+                                               current[(std::size_t)(y + distance)];
+            if (match) {
+                if (next[(std::size_t)y] != current[(std::size_t)y]) { ++saved; }
+                continue;
+            }
+            if (auto const score = saved - std::abs(distance); score > best) {
+                best = score;
+                result = Scroll{
+                    .top = std::min(run_begin, run_begin + distance),
+                    .bottom = std::max(y - 1, y - 1 + distance),
+                    .distance = distance,
+                };
+            }
+            run_begin = y + 1;
+            saved = 0;
+        }
+    }
+    return result;
+}
+
+/**
+ * Apply \p scroll to \p buffer, as a terminal would. Exposed rows are filled with a
+ * null Glyph so they are always redrawn.
+ */
+void apply_scroll(ScreenBuffer& buffer, Scroll scroll)
+{
+    auto const width = buffer.size().width;
+    auto const copy_row = [&](int from, int to) {
+        for (auto x = 0; x < width; ++x) {
+            buffer[{x, to}] = std::as_const(buffer)[{x, from}];
+        }
+    };
+    auto const blank_row = [&](int y) {
+        for (auto x = 0; x < width; ++x) {
+            buffer[{x, y}] = Glyph{U'\0'};
+        }
+    };
+
+    if (scroll.distance > 0) {
+        for (auto y = scroll.top; y <= scroll.bottom; ++y) {
+            auto const from = y + scroll.distance;
+            if (from <= scroll.bottom) { copy_row(from, y); }
+            else {
+                blank_row(y);
+            }
+        }
+    }
+    else {
+        for (auto y = scroll.bottom; y >= scroll.top; --y) {
+            auto const from = y + scroll.distance;
+            if (from >= scroll.top) { copy_row(from, y); }
+            else {
+                blank_row(y);
+            }
+        }
+    }
+}
+
+/**
+ * Number of columns the terminal cursor advances after writing \p symbol.
+ * @details Returns -1 for non-printing and zero width symbols, or if the width can't be
+ * determined in the current locale. The cursor position is then unknown.
+ */
+[[nodiscard]] auto symbol_width(char32_t symbol) -> int
+{
+    if (symbol >= U' ' && symbol < U'\x7F') { return 1; }
+    auto const width = ::wcwidth((wchar_t)symbol);
+    return width > 0 ? width : -1;
+}
+
+/**
+ * Control Sequence with a single numeric parameter, omitted when it is the default 1.
+ */
+[[nodiscard]] auto csi(int n, char final) -> std::string
+{
+    return "\033[" + (n == 1 ? std::string{} : std::to_string(n)) + final;
+}
+
+/**
+ * Append the shortest sequence that moves the terminal cursor from \p from to \p to.
+ * @details If \p from is std::nullopt the cursor position is unknown and an absolute
+ * move is used.
+ */
+void append_cursor_move(std::string& out, std::optional<Point> from, Point to)
+{
+    auto const absolute = escape(esc::Cursor{to});
+    if (!from.has_value()) {
+        out += absolute;
+        return;
+    }
+
+    auto const dx = to.x - from->x;
+    auto horizontal = dx == 0     ? std::string{}
+                      : to.x == 0 ? std::string{"\r"}
+                      : dx > 0    ? csi(dx, 'C')
+                                  : csi(-dx, 'D');
+    if (auto cha = csi(to.x + 1, 'G'); cha.size() < horizontal.size()) {
+        horizontal = std::move(cha);
+    }
+
+    auto const dy = to.y - from->y;
+    auto vertical = dy == 0 ? std::string{} : dy > 0 ? csi(dy, 'B') : csi(-dy, 'A');
+    if (auto vpa = csi(to.y + 1, 'd'); dy != 0 && vpa.size() < vertical.size()) {
+        vertical = std::move(vpa);
+    }
+
+    out += vertical.size() + horizontal.size() < absolute.size() ? vertical + horizontal
+                                                                  : absolute;
+}
+
+/**
+ * A run of identical Glyphs written with a single control sequence.
+ */
+struct RunEncoding {
+    std::string sequence;
+    int advance;  // Columns the cursor is moved forward by the sequence.
+};
+
+/**
+ * Find the shortest encoding of \p count copies of \p glyph written from column \p x.
+ *
+ * @details The current Brush must already be \p glyph's Brush. Erased cells only look
+ * like written cells if they are blank and have no traits. Returns std::nullopt if no
+ * encoding is shorter than \p plain_bytes, the size of writing the cells one by one.
+ */
+[[nodiscard]] auto encode_run(Glyph const& glyph,
+                              int x,
+                              int count,
+                              int screen_width,
+                              Terminal::Capabilities const& capabilities,
+                              std::size_t plain_bytes) -> std::optional<RunEncoding>
+{
+    auto best = std::optional<RunEncoding>{};
+    auto best_bytes = plain_bytes;
+    auto const consider = [&](std::string sequence, int advance, std::size_t bytes) {
+        if (bytes < best_bytes) {
+            best = RunEncoding{std::move(sequence), advance};
+            best_bytes = bytes;
+        }
+    };
+
+    auto const blank =
+        glyph.symbol == U' ' && glyph.brush.traits == Traits{Trait::None};
+    if (capabilities.erase && blank) {
+        if (x + count == screen_width) { consider("\033[K", 0, 3); }
+        else {
+            // The cursor is left at the start of the run and must be moved past it.
+            auto ech = csi(count, 'X');
+            auto const bytes = ech.size() + csi(count, 'C').size();
+            consider(std::move(ech), 0, bytes);
+        }
+    }
+    if (capabilities.repeat && count > 1) {
+        auto rep = esc::detail::u32_to_u8(glyph.symbol) + csi(count - 1, 'b');
+        auto const bytes = rep.size();
+        consider(std::move(rep), count, bytes);
+    }
+    return best;
+}
+
+/**
+ * Ask the terminal if it supports synchronized output, DEC private mode 2026.
+ *
+ * @details Sends a DECRQM query for the mode followed by a DA1 request. Every terminal
+ * answers DA1, so its reply ends the wait even if DECRQM is not recognized. This must
+ * be called in raw mode before the input thread reads from stdin, any other input that
+ * arrives while waiting is discarded.
+ */
+[[nodiscard]] auto query_synchronized_output() -> bool
+{
+    esc::write("\033[?2026$p\033[c");
+    esc::flush();
+
+    // DA1 reply: CSI ? Ps ; ... c
+    auto const has_da1 = [](std::string const& reply) {
+        for (auto at = reply.find("\033[?"); at != std::string::npos;
+             at = reply.find("\033[?", at + 1)) {
+            auto const end = reply.find_first_not_of("0123456789;", at + 3);
+            if (end != std::string::npos && reply[end] == 'c') { return true; }
+        }
+        return false;
+    };
+
+    // DECRPM reply: CSI ? 2026 ; Ps $ y, where Ps is 1 (set) or 2 (reset) if supported.
+    auto const has_mode = [](std::string const& reply) {
+        auto const at = reply.find("\033[?2026;");
+        if (at == std::string::npos || at + 11 > reply.size()) { return false; }
+        auto const ps = reply[at + 8];
+        return (ps == '1' || ps == '2') && reply.compare(at + 9, 2, "$y") == 0;
+    };
+
+    auto reply = std::string{};
+    auto const deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds{200};
+    while (!has_da1(reply)) {
+        auto const remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        auto fd = ::pollfd{.fd = STDIN_FILENO, .events = POLLIN, .revents = 0};
+        if (remaining.count() <= 0 || ::poll(&fd, 1, (int)remaining.count()) <= 0) {
+            return false;
+        }
+        char buffer[64];
+        auto const count = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (count <= 0) { return false; }
+        reply.append(buffer, (std::size_t)count);
+    }
+    return has_mode(reply);
+}
+
+// Self-pipe that wakes the input thread, {read end, write end}, -1 if unavailable.
+auto wakeup_pipe = std::array<int, 2>{-1, -1};
+
+// Handlers replaced by forward_and_wake, for SIGINT and SIGWINCH.
+auto chained_handlers = std::array<struct ::sigaction, 2>{};
+
+/// Async-signal-safe, the pipe is non-blocking so a full pipe drops the byte.
+void wake_input_thread()
+{
+    auto const saved_errno = errno;
+    auto const byte = char{0};
+    [[maybe_unused]] auto const result = ::write(wakeup_pipe[1], &byte, 1);
+    errno = saved_errno;
+}
+
+void forward_and_wake(int sig)
+{
+    chained_handlers[sig == SIGINT ? 0 : 1].sa_handler(sig);
+    wake_input_thread();
+}
+
+/**
+ * Opens the wakeup pipe and chains onto the SIGINT and SIGWINCH handlers installed by
+ * esc, so the input thread can block in poll() without missing those signals.
+ *
+ * @details Default and ignored dispositions are left alone, there is nothing for the
+ * input thread to report for them.
+ */
+void install_wakeup()
+{
+    if (wakeup_pipe[0] == -1) {
+        if (::pipe(wakeup_pipe.data()) != 0) { return; }
+        for (auto const fd : wakeup_pipe) {
+            ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+
+    auto const signals = std::array{SIGINT, SIGWINCH};
+    for (auto i = std::size_t{0}; i < signals.size(); ++i) {
+        struct ::sigaction current = {};
+        ::sigaction(signals[i], nullptr, &current);
+        if ((current.sa_flags & SA_SIGINFO) != 0 || current.sa_handler == SIG_DFL ||
+            current.sa_handler == SIG_IGN || current.sa_handler == &forward_and_wake) {
+            continue;
+        }
+        chained_handlers[i] = current;
+        current.sa_handler = &forward_and_wake;
+        ::sigaction(signals[i], &current, nullptr);
+    }
+}
+
+/// A file descriptor registered with Terminal::watch.
+struct Watch {
+    int id;
+    int fd;
+    std::function<ox::EventResponse(int)> on_ready;
+    std::coroutine_handle<> waiter;  // One-shot watch if set, on_ready is unused.
+    std::atomic<bool> armed = true;     // False while a readiness event is queued.
+    std::atomic<bool> removed = false;  // Set by unwatch, pending events are dropped.
+};
+
+// Shared between the event loop thread, which registers watches, and the input thread,
+// which polls them.
+auto watch_mutex = std::mutex{};
+auto watches = std::map<int, std::shared_ptr<Watch>>{};
+auto next_watch_id = 0;
+
+void remove_watch(int id)
+{
+    auto const lock = std::scoped_lock{watch_mutex};
+    if (auto const at = watches.find(id); at != std::end(watches)) {
+        at->second->removed = true;
+        watches.erase(at);
+    }
+}
+
+auto add_watch(int fd,
+               std::function<ox::EventResponse(int)> on_ready,
+               std::coroutine_handle<> waiter) -> int
+{
+    auto id = 0;
+    {
+        auto const lock = std::scoped_lock{watch_mutex};
+        id = next_watch_id++;
+        watches.emplace(id,
+                        std::make_shared<Watch>(id, fd, std::move(on_ready), waiter));
+    }
+    wake_input_thread();
+    return id;
+}
+
+/// Posts an event that calls the watch's callback on the event loop thread.
+void post_ready(std::shared_ptr<Watch> const& w)
+{
+    if (w->waiter) {
+        remove_watch(w->id);
+        ox::Terminal::event_queue.enqueue(ox::event::Resume{w->waiter});
+        return;
+    }
+    w->armed = false;
+    ox::Terminal::event_queue.enqueue(ox::event::Custom{[w]() -> ox::EventResponse {
+        if (w->removed) { return std::nullopt; }
+        auto const response = w->on_ready(w->fd);
+        w->armed = true;
+        wake_input_thread();  // Polled again from here.
+        return response;
+    }});
+}
+
+}  // namespace
+
+namespace ox::detail {
+
+void resume_when_readable(int fd, std::coroutine_handle<> h)
+{
+    [[maybe_unused]] auto const id = add_watch(fd, nullptr, h);
+}
+
+void append_sgr_delta(std::string& out, Brush const& from, Brush const& to)
+{
+    if (from.traits != to.traits) {
+        // Not a reset (SGR 0), so the colors are left as they are.
+        if (from.traits != Traits{Trait::None}) { out += "\033[22;23;24;25;27;28;29m"; }
+        out += escape(to.traits);
+    }
+    if (from.background != to.background) { out += escape(ColorBG{to.background}); }
+    if (from.foreground != to.foreground) { out += escape(ColorFG{to.foreground}); }
+}
+
+FrameWriter::FrameWriter(std::function<void(std::string_view)> output)
+    : output_{std::move(output)}, thread_{[this](std::stop_token st) { this->run(st); }}
+{}
+
+FrameWriter::~FrameWriter()
+{
+    this->wait();
+    thread_.request_stop();
+}
+
+void FrameWriter::submit(std::string& frame)
+{
+    {
+        auto const lock = std::scoped_lock{mtx_};
+        if (pending_.empty()) { std::swap(pending_, frame); }
+        else {
+            // The thread is still writing an earlier frame, they are written in order.
+            pending_ += frame;
+        }
+    }
+    frame.clear();
+    frame_ready_.notify_one();
+}
+
+void FrameWriter::wait()
+{
+    auto lock = std::unique_lock{mtx_};
+    frame_written_.wait(lock, [this] { return pending_.empty() && !writing_; });
+}
+
+auto FrameWriter::would_wait() -> bool
+{
+    auto const lock = std::scoped_lock{mtx_};
+    return writing_ && pending_.empty();
+}
+
+auto FrameWriter::retract() -> bool
+{
+    auto const lock = std::scoped_lock{mtx_};
+    if (pending_.empty()) { return false; }
+    pending_.clear();
+    return true;
+}
+
+void FrameWriter::run(std::stop_token st)
+{
+    auto frame = std::string{};
+    auto lock = std::unique_lock{mtx_};
+    while (frame_ready_.wait(lock, st, [this] { return !pending_.empty(); })) {
+        std::swap(frame, pending_);
+        writing_ = true;
+        lock.unlock();
+
+        if (output_ != nullptr) { output_(frame); }
+        else {
+            esc::write(frame);
+            esc::flush();
+            ::tcdrain(STDOUT_FILENO);  // Busy until the terminal has read the frame.
+        }
+        frame.clear();
+
+        lock.lock();
+        writing_ = false;
+        frame_written_.notify_all();
+    }
+}
+
+}  // namespace ox::detail
+
 namespace ox {
 
 ScreenBuffer::ScreenBuffer(Area size)
-    : size_{size}, buffer_((std::size_t)(size.width * size.height))
+    : size_{size},
+      buffer_((std::size_t)(size.width * size.height)),
+      damage_((std::size_t)size.height, Span{0, size.width})
 {}
 
 auto ScreenBuffer::operator[](Point p) -> Glyph&
 {
     auto const at = (std::size_t)(p.y * size_.width + p.x);
     assert(at < buffer_.size());
+    auto& span = damage_[(std::size_t)p.y];
+    span.begin = std::min(span.begin, p.x);
+    span.end = std::max(span.end, p.x + 1);
+    if (track_written_) { written_[at] = true; }
     return buffer_[at];
 }
 
@@ -33,6 +575,8 @@ void ScreenBuffer::resize(Area a)
 {
     size_ = a;
     buffer_.resize((std::size_t)(a.width * a.height));
+    damage_.assign((std::size_t)a.height, Span{0, a.width});
+    if (track_written_) { written_.assign(buffer_.size(), true); }
 }
 
 void ScreenBuffer::fill(Glyph const& g)
@@ -40,107 +584,458 @@ void ScreenBuffer::fill(Glyph const& g)
     for (auto& glyph : buffer_) {
         glyph = g;
     }
+    std::ranges::fill(damage_, Span{0, size_.width});
+    if (track_written_) { written_.assign(buffer_.size(), true); }
+}
+
+void ScreenBuffer::track_written(bool enabled)
+{
+    track_written_ = enabled;
+    written_.assign(enabled ? buffer_.size() : 0, false);
+    if (!enabled) { return; }
+    for (auto y = 0; y < size_.height; ++y) {
+        auto const span = damage_[(std::size_t)y];
+        for (auto x = span.begin; x < span.end; ++x) {
+            written_[(std::size_t)(y * size_.width + x)] = true;
+        }
+    }
+}
+
+auto ScreenBuffer::damage_count() const -> std::size_t
+{
+    auto count = std::size_t{0};
+    for (auto const& span : damage_) {
+        if (!span.empty()) { count += (std::size_t)(span.end - span.begin); }
+    }
+    return count;
+}
+
+void ScreenBuffer::clear_damage()
+{
+    if (track_written_) {
+        for (auto y = 0; y < size_.height; ++y) {
+            auto const span = damage_[(std::size_t)y];
+            for (auto x = span.begin; x < span.end; ++x) {
+                written_[(std::size_t)(y * size_.width + x)] = false;
+            }
+        }
+    }
+    std::ranges::fill(damage_, Span{size_.width, 0});
+}
+
+void ScreenBuffer::reset_damaged(Glyph const& g)
+{
+    for (auto y = 0; y < size_.height; ++y) {
+        auto const span = damage_[(std::size_t)y];
+        for (auto x = span.begin; x < span.end; ++x) {
+            buffer_[(std::size_t)(y * size_.width + x)] = g;
+        }
+    }
+    this->clear_damage();
 }
 
 // -------------------------------------------------------------------------------------
 
 Terminal::Terminal(Options x)
-    : Terminal{x.mouse_mode, x.key_mode, x.signals, x.foreground, x.background}
-{}
+    : foreground{x.foreground},
+      background{x.background},
+      capabilities{x.capabilities},
+      paint_policy{x.paint_policy},
+      event_coalescing{x.event_coalescing},
+      output_{std::move(x.output)}
+{
+    if (x.threaded_output) {
+        frame_writer_ = std::make_unique<detail::FrameWriter>(output_);
+    }
+    if (output_ != nullptr) { return; }
+
+    esc::initialize_interactive_terminal(x.mouse_mode, x.key_mode, x.signals);
+
+    // Replies to the query would be read as input once the read loop is started.
+    if (capabilities.synchronized_output) {
+        capabilities.synchronized_output = query_synchronized_output();
+    }
+
+    install_wakeup();
+    terminal_input_thread_ = std::jthread{[this](auto st) { this->run_read_loop(st); }};
+}
 
 Terminal::Terminal(MouseMode mouse_mode,
                    KeyMode key_mode,
                    Signals signals,
                    Color foreground_,
                    Color background_)
-    : foreground{foreground_},
-      background{background_},
-      terminal_input_thread_{[this](auto st) { this->run_read_loop(st); }}
-{
-    esc::initialize_interactive_terminal(mouse_mode, key_mode, signals);
-}
+    : Terminal{Options{
+          .mouse_mode = mouse_mode,
+          .key_mode = key_mode,
+          .signals = signals,
+          .foreground = foreground_,
+          .background = background_,
+      }}
+{}
 
 Terminal::~Terminal()
 {
     terminal_input_thread_.request_stop();
-    esc::uninitialize_terminal();
+    frame_writer_.reset();  // Writes any remaining frames.
+    if (output_ == nullptr) { esc::uninitialize_terminal(); }
 }
 
 void Terminal::commit_changes()
 {
     escape_sequence_.clear();
 
-    if (this->changes.size() != current_screen_.size()) {
-        current_screen_.resize(this->changes.size());
+    // Under backpressure a frame that is still waiting for the writer thread is dropped
+    // and this frame is diffed against the screen the dropped frame started from, so
+    // the terminal is sent a single frame that converges on the latest state.
+    auto coalesced = false;
+    if (frame_writer_ != nullptr) {
+        if (base_screen_.has_value() && frame_writer_->retract()) {
+            current_screen_ = *base_screen_;
+            current_hashes_ = base_hashes_;
+            auto const base_size = current_screen_.size();
+            previous_damage_.assign((std::size_t)base_size.height,
+                                    {0, base_size.width});
+            coalesced = true;
+        }
+        else if (frame_writer_->would_wait()) {
+            base_screen_ = current_screen_;
+            base_hashes_ = current_hashes_;
+        }
+        else {
+            base_screen_.reset();
+        }
+    }
+
+    // The terminal holds back drawing until the end of the update, so it can't tear.
+    if (capabilities.synchronized_output) { escape_sequence_ += "\033[?2026h"; }
+    escape_sequence_ += escape(esc::CursorMode::Hide);
+    auto const frame_begin = escape_sequence_.size();
+
+    auto const size = this->changes.size();
+
+    if (size != current_screen_.size()) {
+        current_screen_.resize(size);
         current_screen_.fill(Glyph{U'\0'});  // Trigger Repaint
+        previous_damage_.assign((std::size_t)size.height, {0, size.width});
+        current_hashes_.assign((std::size_t)size.height,
+                               row_hash(current_screen_, 0, foreground, background));
+    }
+
+    // Resolved colors are stored in current_screen_, so every cell must be diffed.
+    if (this->foreground != previous_foreground_ ||
+        this->background != previous_background_) {
+        previous_damage_.assign((std::size_t)size.height, {0, size.width});
+        previous_foreground_ = this->foreground;
+        previous_background_ = this->background;
+    }
+
+    // Cells painted last frame but not this frame must be diffed to be cleared.
+    auto spans = std::vector<ScreenBuffer::Span>((std::size_t)size.height);
+    for (auto y = 0; y < size.height; ++y) {
+        auto const now = this->changes.damage(y);
+        auto const before = previous_damage_[(std::size_t)y];
+        spans[(std::size_t)y] =
+            now.empty()      ? before
+            : before.empty() ? now
+                             : ScreenBuffer::Span{
+                                   .begin = std::min(now.begin, before.begin),
+                                   .end = std::max(now.end, before.end),
+                               };
+    }
+
+    auto stats = FrameStats{.coalesced = coalesced};
+
+    if (capabilities.scroll_region) {
+        // Undamaged rows of `changes` are blank, so they share a single hash. When
+        // retained, rows with nothing to diff already match the current screen.
+        auto const blank_hash = [&] {
+            auto hash = std::uint64_t{0xcbf29ce484222325};
+            for (auto x = 0; x < size.width; ++x) {
+                hash_append(hash, resolve(Glyph{}, foreground, background));
+            }
+            return hash;
+        }();
+        auto next_hashes = std::vector<std::uint64_t>((std::size_t)size.height);
+        auto differing = 0;
+        for (auto y = 0; y < size.height; ++y) {
+            auto& hash = next_hashes[(std::size_t)y];
+            if (paint_policy.retained) {
+                hash = spans[(std::size_t)y].empty()
+                           ? current_hashes_[(std::size_t)y]
+                           : row_hash(this->changes, y, foreground, background);
+            }
+            else {
+                hash = this->changes.damage(y).empty()
+                           ? blank_hash
+                           : row_hash(this->changes, y, foreground, background);
+            }
+            if (hash != current_hashes_[(std::size_t)y]) { ++differing; }
+        }
+
+        if (differing > 2) {
+            if (auto const scroll = find_scroll(next_hashes, current_hashes_)) {
+                escape_sequence_ += "\033[" + std::to_string(scroll->top + 1) + ';' +
+                                    std::to_string(scroll->bottom + 1) + 'r';
+                auto const distance = std::abs(scroll->distance);
+                escape_sequence_ += "\033[" + std::to_string(distance) +
+                                    (scroll->distance > 0 ? 'S' : 'T');
+                escape_sequence_ += "\033[r";
+
+                apply_scroll(current_screen_, *scroll);
+                for (auto y = scroll->top; y <= scroll->bottom; ++y) {
+                    current_hashes_[(std::size_t)y] =
+                        row_hash(current_screen_, y, foreground, background);
+                    spans[(std::size_t)y] = {0, size.width};
+                }
+                stats.scrolled_rows = scroll->distance;
+            }
+        }
     }
 
     auto brush = Brush{};
 
-    for (auto y = 0; y < this->changes.size().height; ++y) {
-        for (auto x = 0; x < this->changes.size().width; ++x) {
-            auto const change = [&] {
-                auto g = this->changes[{x, y}];
-                if (g.brush.background == Color{TermColor::Default}) {
-                    g.brush.background = this->background;
+    // Tracks the terminal's cursor, std::nullopt when its position isn't known; at the
+    // start of each frame, after a scroll and after writing to the last column.
+    auto pen = std::optional<Point>{};
+
+    for (auto y = 0; y < size.height; ++y) {
+        auto const span = spans[(std::size_t)y];
+        if (span.empty()) { continue; }
+        stats.dirty_cells += (std::size_t)(span.end - span.begin);
+
+        auto const changed_before = stats.changed_cells;
+        auto end = span.end;
+        for (auto x = span.begin; x < end; ++x) {
+            auto const change =
+                resolve(std::as_const(this->changes)[{x, y}], foreground, background);
+            auto& current = current_screen_[{x, y}];
+
+            // The right half of a wide glyph covers this cell, so it is never written.
+            auto const left = x > 0 ? std::as_const(current_screen_)[{x - 1, y}].symbol
+                                    : U'\0';
+            if (symbol_width(left) == 2) {
+                current = change;
+                continue;
+            }
+            if (change == current) { continue; }
+
+            if (!pen.has_value() || pen->x != x || pen->y != y) {
+                // Re-printing a few unchanged cells can be shorter than a move.
+                auto reprint = std::string{};
+                if (pen.has_value() && pen->y == y && pen->x < x && x - pen->x <= 3) {
+                    for (auto i = pen->x; i < x; ++i) {
+                        auto const& skipped = std::as_const(current_screen_)[{i, y}];
+                        if (skipped.brush != brush ||
+                            symbol_width(skipped.symbol) != 1) {
+                            reprint.clear();
+                            break;
+                        }
+                        reprint += esc::detail::u32_to_u8(skipped.symbol);
+                    }
                 }
-                if (g.brush.foreground == Color{TermColor::Default}) {
-                    g.brush.foreground = this->foreground;
+                auto move = std::string{};
+                append_cursor_move(move, pen, {x, y});
+                escape_sequence_ += !reprint.empty() && reprint.size() <= move.size()
+                                        ? reprint
+                                        : move;
+            }
+            if (change.brush != brush) {
+                detail::append_sgr_delta(escape_sequence_, brush, change.brush);
+                brush = change.brush;
+            }
+
+            // Cells to the right with the same Glyph form a run, which includes cells
+            // that are unchanged, since they might be cheaper to rewrite than skip.
+            auto const width = symbol_width(change.symbol);
+            auto run = 1;
+            auto differing = std::size_t{1};
+            if (width == 1 && (capabilities.erase || capabilities.repeat)) {
+                for (; x + run < size.width; ++run) {
+                    auto const next =
+                        resolve(std::as_const(this->changes)[{x + run, y}], foreground,
+                                background);
+                    if (next != change) { break; }
+                    if (next != std::as_const(current_screen_)[{x + run, y}]) {
+                        ++differing;
+                    }
                 }
-                return g;
-            }();
-            auto const& current = current_screen_[{x, y}];
-            if (change != current) {
-                escape_sequence_ += escape(esc::Cursor{x, y});
-                if (change.brush != brush) {
-                    escape_sequence_ += escape(change.brush);
-                    brush = change.brush;
+            }
+            auto const symbol = esc::detail::u32_to_u8(change.symbol);
+            auto const encoded =
+                run > 1 ? encode_run(change, x, run, size.width, capabilities,
+                                     differing * symbol.size())
+                        : std::nullopt;
+            if (!encoded.has_value()) {
+                run = 1;
+                differing = 1;
+            }
+            escape_sequence_ += encoded.has_value() ? encoded->sequence : symbol;
+
+            // Writing over the left half of a wide glyph erases its right half, so that
+            // is redrawn.
+            auto const covered = x + (run == 1 ? std::max(width, 1) : run);
+            for (auto i = x; i < std::min(covered, size.width - 1); ++i) {
+                if (symbol_width(std::as_const(current_screen_)[{i, y}].symbol) == 2) {
+                    current_screen_[{i + 1, y}] = Glyph{U'\0'};
+                    end = std::max(end, i + 2);
                 }
-                escape_sequence_ += esc::detail::u32_to_u8(change.symbol);
-                current_screen_[{x, y}] = change;
             }
+            for (auto i = x; i < x + run; ++i) {
+                current_screen_[{i, y}] = change;
+            }
+            stats.changed_cells += differing;
+
+            // At the last column the cursor is left in a pending wrap state.
+            auto const advance = encoded.has_value() ? encoded->advance : width;
+            if (advance == 0) { pen = Point{x, y}; }
+            else if (advance > 0 && x + advance < size.width) {
+                pen = Point{x + advance, y};
+            }
+            else {
+                pen = std::nullopt;
+            }
+            x += run - 1;
+        }
+        if (stats.changed_cells != changed_before) {
+            current_hashes_[(std::size_t)y] =
+                row_hash(current_screen_, y, foreground, background);
         }
     }
-    // Reset brush for consistency with above optimization.
-    escape_sequence_ += escape(Brush{});
+    // Each frame starts from the default Brush, as the SGR deltas assume.
+    if (brush != Brush{}) { escape_sequence_ += "\033[0m"; }
 
-    this->changes.fill(Glyph{});
+    if (paint_policy.retained) {
+        // Cells are kept, so next frame only the cells painted over can differ.
+        previous_damage_.assign((std::size_t)size.height, {size.width, 0});
+        this->changes.clear_damage();
+    }
+    else {
+        // Only damaged cells can differ from a blank Glyph, so only they are reset.
+        previous_damage_.resize((std::size_t)size.height);
+        for (auto y = 0; y < size.height; ++y) {
+            previous_damage_[(std::size_t)y] = this->changes.damage(y);
+        }
+        this->changes.reset_damaged(Glyph{});
+    }
 
-    set(esc::CursorMode::Hide);
-    esc::write(escape_sequence_);
+    stats.bytes = escape_sequence_.size() - frame_begin;
+    frame_stats_ = stats;
 
     if (cursor.has_value()) {
-        set(esc::CursorMode::Show);
-        esc::write(escape(esc::Cursor{*cursor}));
+        escape_sequence_ += escape(esc::CursorMode::Show);
+        escape_sequence_ += escape(esc::Cursor{*cursor});
     }
+
+    if (capabilities.synchronized_output) { escape_sequence_ += "\033[?2026l"; }
+
+    if (frame_writer_ != nullptr) { frame_writer_->submit(escape_sequence_); }
+    else if (output_ != nullptr) { output_(escape_sequence_); }
     else {
-        esc::set(esc::CursorMode::Hide);
+        esc::write(escape_sequence_);
+        esc::flush();
     }
-
-    esc::flush();
 }
 
 void Terminal::run_read_loop(std::stop_token st)
 {
     Terminal::event_queue.enqueue(esc::Resize{Terminal::size()});
 
+    // Blocks in poll() until stdin is readable, or until a stop request or a chained
+    // signal handler writes to the wakeup pipe. Without the pipe, poll every 16ms.
+    auto const wake_on_stop = std::stop_callback{st, [] { wake_input_thread(); }};
+    auto fds = std::vector{
+        ::pollfd{.fd = STDIN_FILENO, .events = POLLIN, .revents = 0},
+        ::pollfd{.fd = wakeup_pipe[0], .events = POLLIN, .revents = 0},
+    };
+    auto polled = std::vector<std::shared_ptr<Watch>>{};  // Watches from fds[2].
+    auto const timeout = wakeup_pipe[0] == -1 ? 16 : -1;
+
     while (!st.stop_requested()) {
         if (esc::sigint_flag == 1) {
             Terminal::event_queue.enqueue(event::Interrupt{});
             return;
         }
-        else if (auto const event = esc::read(16); event.has_value()) {
+
+        // Everything ready is read before sleeping, including a pending Resize.
+        while (auto const event = esc::read(0)) {
             Terminal::event_queue.enqueue(
                 std::visit([](auto const& e) -> Event { return e; }, *event));
             // ^^ Translate from esc::Event to ox::Event ^^
         }
+
+        // Watches with an event still queued are left out until it has been handled.
+        fds.resize(2);
+        polled.clear();
+        {
+            auto const lock = std::scoped_lock{watch_mutex};
+            for (auto const& [id, w] : watches) {
+                if (!w->armed) { continue; }
+                fds.push_back(::pollfd{.fd = w->fd, .events = POLLIN, .revents = 0});
+                polled.push_back(w);
+            }
+        }
+
+        if (::poll(fds.data(), (::nfds_t)fds.size(), timeout) < 0) { continue; }
+        if ((fds[1].revents & POLLIN) != 0) {
+            char buffer[64];
+            while (::read(fds[1].fd, buffer, sizeof(buffer)) > 0) {}
+        }
+        // A closed stdin would otherwise wake poll() continuously.
+        if ((fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) != 0) { fds[0].fd = -1; }
+
+        for (auto i = std::size_t{0}; i < polled.size(); ++i) {
+            auto const revents = fds[i + 2].revents;
+            if (revents == 0) { continue; }
+            // A closed fd is dropped, a waiting coroutine is still resumed to see it.
+            if ((revents & POLLNVAL) != 0 && !polled[i]->waiter) {
+                remove_watch(polled[i]->id);
+            }
+            else {
+                post_ready(polled[i]);
+            }
+        }
     }
 }
 
+auto Terminal::watch(int fd, std::function<EventResponse(int)> on_ready) -> int
+{
+    return add_watch(fd, std::move(on_ready), nullptr);
+}
+
+void Terminal::unwatch(int id)
+{
+    remove_watch(id);
+    wake_input_thread();
+}
+
 auto Terminal::size() -> Area { return esc::terminal_area(); }
 
 // -------------------------------------------------------------------------------------
 
+auto is_superseded(Event const& event,
+                   Event const& next,
+                   Terminal::EventCoalescing const& coalescing) -> bool
+{
+    if (coalescing.mouse_move) {
+        auto const* const a = std::get_if<esc::MouseMove>(&event);
+        auto const* const b = std::get_if<esc::MouseMove>(&next);
+        if (a != nullptr && b != nullptr) {
+            auto const& ma = a->mouse.modifiers;
+            auto const& mb = b->mouse.modifiers;
+            return a->mouse.button == b->mouse.button && ma.shift == mb.shift &&
+                   ma.ctrl == mb.ctrl && ma.alt == mb.alt;
+        }
+    }
+    if (coalescing.resize) {
+        return std::holds_alternative<esc::Resize>(event) &&
+               std::holds_alternative<esc::Resize>(next);
+    }
+    return false;
+}
+
+// -------------------------------------------------------------------------------------
+
 auto Canvas::operator[](Point p) -> Glyph&
 {
     return buffer[{.x = at.x + p.x, .y = at.y + p.y}];
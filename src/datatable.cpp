@@ -31,6 +31,7 @@ void DataTable::add_column(std::string heading, Align align, Color foreground)
     }});
     auto const existing_size = columns_.empty() ? 0 : columns_.front().size();
     columns_.push_back(std::vector<std::string>(existing_size, ""));
+    this->update();
 }
 
 void DataTable::add_row(std::vector<std::string> row)
@@ -42,6 +43,7 @@ void DataTable::add_row(std::vector<std::string> row)
     for (auto i = std::size_t{0}; i < columns_.size(); ++i) {
         columns_[i].push_back(std::move(row[i]));
     }
+    this->update();
     this->on_scroll((int)this->offset, (int)columns_.back().size());
 }
 
@@ -160,13 +162,14 @@ void DataTable::resize(Area)
         .height = std::min(1, size.height),
     };
     headings_.resize(old_size);
+    this->update();
 }
 
-auto DataTable::get_children() -> zzz::Generator<Widget&> { co_yield headings_; }
+void DataTable::for_each_child(FunctionRef<void(Widget&)> fn) { fn(headings_); }
 
-auto DataTable::get_children() const -> zzz::Generator<Widget const&>
+void DataTable::for_each_child(FunctionRef<void(Widget const&)> fn) const
 {
-    co_yield headings_;
+    fn(headings_);
 }
 
 void link(DataTable& dt, ScrollBar& sb)
@@ -181,12 +184,17 @@ void link(DataTable& dt, ScrollBar& sb)
             [](int pos, int len, ScrollBar& sb) {
                 sb.position = pos;
                 sb.scrollable_length = len;
+                sb.update();
             },
     }(sb);
 
     Connection{
         .signal = sb.on_scroll,
-        .slot = [](int pos, DataTable& dt) { dt.offset = (std::size_t)pos; },
+        .slot =
+            [](int pos, DataTable& dt) {
+                dt.offset = (std::size_t)pos;
+                dt.update();
+            },
     }(dt);
 }
 
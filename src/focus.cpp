@@ -8,15 +8,18 @@ void Focus::set(Widget& w)
 {
     if (in_focus_.valid()) {
         in_focus_.get().focus_out();
+        in_focus_.get().update();
     }
     in_focus_ = track(w);
     w.focus_in();
+    w.update();
 }
 
 void Focus::clear()
 {
     if (in_focus_.valid()) {
         in_focus_.get().focus_out();
+        in_focus_.get().update();
     }
     in_focus_ = std::shared_ptr<Widget*>{nullptr};
 }
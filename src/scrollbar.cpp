@@ -81,12 +81,12 @@ void ScrollBar::paint(Canvas c)
 void ScrollBar::mouse_press(Mouse m)
 {
     if (m.button == Mouse::Button::Left) {
-        time_at_click_ = ClockType::now();
+        since_click_ = {};
         position_at_click_ = position;
         target_position_ =
             (int)((float)(std::max(scrollable_length - 1, 0)) *
                   ((float)m.at.y / (float)std::max(this->size.height - 1, 0)));
-        timer_.start();
+        animation_.start();
     }
 }
 
@@ -94,34 +94,32 @@ void ScrollBar::mouse_wheel(Mouse m)
 {
     constexpr auto percent_scrolll = 0.15f;
     if (m.button == Mouse::Button::ScrollDown) {
-        time_at_click_ = ClockType::now();
+        since_click_ = {};
         position_at_click_ = position;
         target_position_ = std::min(
             (int)((float)position + (percent_scrolll * (float)scrollable_length)),
             std::max(scrollable_length - 1, 0));
-        timer_.start();
+        animation_.start();
     }
     else if (m.button == Mouse::Button::ScrollUp) {
-        time_at_click_ = ClockType::now();
+        since_click_ = {};
         position_at_click_ = position;
         target_position_ = std::max(
             (int)((float)position - (percent_scrolll * (float)scrollable_length)), 0);
-        timer_.start();
+        animation_.start();
     }
 }
 
-void ScrollBar::timer()
+void ScrollBar::animate(std::chrono::nanoseconds dt)
 {
     if (position == target_position_) {
-        timer_.stop();
+        animation_.stop();
         return;
     }
 
-    auto const time_since_click = ClockType::now() - time_at_click_;
-    auto t =
-        (float)std::chrono::duration_cast<std::chrono::milliseconds>(time_since_click)
-            .count() /
-        (float)scroll_settle_time.count();
+    since_click_ += dt;
+    auto t = std::chrono::duration<float>{since_click_} /
+             std::chrono::duration<float>{scroll_settle_time};
 
     t = std::clamp(t, 0.f, 1.f);
 
@@ -137,6 +135,7 @@ void ScrollBar::increment_position(int amount)
 {
     position += amount;
     position = std::clamp(0, position, std::max(scrollable_length - 1, 0));
+    this->update();
 }
 
 }  // namespace ox
\ No newline at end of file
@@ -161,6 +161,7 @@ TextBox::TextBox(Options x)
 void TextBox::set_scroll_offset(int position)
 {
     scroll_offset_ = std::clamp(position, 0, this->get_scroll_length());
+    this->update();
 
     // Adjust cursor if needed.
     auto at = index_to_point(cursor_index_, line_lengths(text_layout_));
@@ -315,6 +316,7 @@ void link(TextBox& tb, ScrollBar& sb)
             [](int pos, int len, ScrollBar& sb) {
                 sb.position = pos;
                 sb.scrollable_length = len;
+                sb.update();
             },
     }(sb);
 
@@ -0,0 +1,106 @@
+#include <ox/thread_pool.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+
+namespace {
+
+// The pool and worker index of the current thread, if it is a pool worker.
+thread_local ox::ThreadPool const* current_pool = nullptr;
+thread_local std::size_t current_index = 0;
+
+}  // namespace
+
+namespace ox {
+
+ThreadPool::ThreadPool(std::size_t thread_count)
+{
+    thread_count = std::max(thread_count, std::size_t{1});
+    workers_.reserve(thread_count);
+    for (auto i = std::size_t{0}; i < thread_count; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    threads_.reserve(thread_count);
+    for (auto i = std::size_t{0}; i < thread_count; ++i) {
+        threads_.emplace_back([this, i](std::stop_token st) { this->run(i, st); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    for (auto& thread : threads_) {
+        thread.request_stop();
+    }
+    threads_.clear();  // Joins
+    for (auto& worker : workers_) {
+        for (auto* const job : worker->jobs) {
+            job->cancel();
+        }
+        worker->jobs.clear();
+    }
+}
+
+void ThreadPool::push(detail::PoolJob& job)
+{
+    auto const index = current_pool == this
+                           ? current_index
+                           : next_worker_.fetch_add(1) % workers_.size();
+    {
+        auto& worker = *workers_[index];
+        auto const lock = std::scoped_lock{worker.mtx};
+        worker.jobs.push_back(&job);
+    }
+    queued_.fetch_add(1);
+    { auto const lock = std::scoped_lock{sleep_mtx_}; }  // No lost wakeup.
+    job_ready_.notify_one();
+}
+
+auto ThreadPool::default_thread_count() -> std::size_t
+{
+    return std::max(std::thread::hardware_concurrency(), 2u);
+}
+
+void ThreadPool::run(std::size_t index, std::stop_token st)
+{
+    current_pool = this;
+    current_index = index;
+    while (!st.stop_requested()) {
+        if (auto* const job = this->take(index); job != nullptr) {
+            job->run();
+            continue;
+        }
+        auto lock = std::unique_lock{sleep_mtx_};
+        job_ready_.wait(lock, st, [this] { return queued_.load() > 0; });
+    }
+}
+
+auto ThreadPool::take(std::size_t index) -> detail::PoolJob*
+{
+    {
+        auto& own = *workers_[index];
+        auto const lock = std::scoped_lock{own.mtx};
+        if (!own.jobs.empty()) {
+            auto* const job = own.jobs.back();
+            own.jobs.pop_back();
+            queued_.fetch_sub(1);
+            return job;
+        }
+    }
+    for (auto i = std::size_t{1}; i < workers_.size(); ++i) {
+        auto& victim = *workers_[(index + i) % workers_.size()];
+        auto const lock = std::scoped_lock{victim.mtx};
+        if (!victim.jobs.empty()) {
+            auto* const job = victim.jobs.front();
+            victim.jobs.pop_front();
+            queued_.fetch_sub(1);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+}  // namespace ox
@@ -1,43 +1,235 @@
 #include <ox/timer.hpp>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
 #include <utility>
-
-#include <zzz/timer_thread.hpp>
+#include <vector>
 
 #include <ox/application.hpp>
 #include <ox/core/terminal.hpp>
 #include <ox/widget.hpp>
 
+namespace {
+
+/**
+ * Hashed timing wheel run on a single thread, shared by every Timer.
+ *
+ * @details Each slot is one millisecond; a Timer further away than one revolution waits
+ * for `rounds` passes over its slot. Scheduling appends to a slot and cancelling bumps
+ * the Timer's generation, so both are O(1). Cancelled entries are dropped when their
+ * slot comes up. The thread sleeps until the next occupied slot, or indefinitely when
+ * no Timer is running.
+ */
+class TimerWheel {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+   public:
+    /// The process wide wheel, the thread is launched on first use.
+    [[nodiscard]] static auto instance() -> TimerWheel&
+    {
+        static auto wheel = TimerWheel{};
+        return wheel;
+    }
+
+   public:
+    /**
+     * Post `event::Timer{id}` every `period` while `state->generation == generation`.
+     */
+    void schedule(int id,
+                  std::shared_ptr<ox::detail::TimerState> state,
+                  std::chrono::milliseconds period,
+                  std::uint64_t generation)
+    {
+        auto const ticks = (std::uint64_t)std::max<std::int64_t>(period.count(), 1);
+        {
+            auto const lock = std::lock_guard{mtx_};
+            auto const due = std::max(this->tick_of(Clock::now()) + ticks, next_tick_);
+            this->insert(Entry{
+                .id = id,
+                .state = std::move(state),
+                .generation = generation,
+                .period = ticks,
+                .due = due,
+                .waiter = nullptr,
+            });
+            changed_ = true;
+        }
+        wake_.notify_one();
+    }
+
+    /**
+     * Post `event::Resume{h}` once, after \p delay.
+     */
+    void schedule_once(std::chrono::milliseconds delay, std::coroutine_handle<> h)
+    {
+        auto const ticks = (std::uint64_t)std::max<std::int64_t>(delay.count(), 1);
+        {
+            auto const lock = std::lock_guard{mtx_};
+            auto const due = std::max(this->tick_of(Clock::now()) + ticks, next_tick_);
+            this->insert(Entry{
+                .id = -1,
+                .state = nullptr,
+                .generation = 0,
+                .period = 0,
+                .due = due,
+                .waiter = h,
+            });
+            changed_ = true;
+        }
+        wake_.notify_one();
+    }
+
+   private:
+    struct Entry {
+        int id;
+        std::shared_ptr<ox::detail::TimerState> state;
+        std::uint64_t generation;
+        std::uint64_t period;  // In ticks.
+        std::uint64_t due;     // Tick at which the entry fires.
+        std::coroutine_handle<> waiter;  // One-shot entry if set, state is unused.
+    };
+
+    static constexpr auto slot_count = std::size_t{512};
+
+   private:
+    TimerWheel() : thread_{[this](std::stop_token st) { this->run(st); }} {}
+
+   private:
+    [[nodiscard]] auto tick_of(Clock::time_point t) const -> std::uint64_t
+    {
+        return (std::uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+                   t - start_)
+            .count();
+    }
+
+    void insert(Entry e)
+    {
+        slots_[e.due % slot_count].push_back(std::move(e));
+        ++size_;
+    }
+
+    /// Fire or age every entry in the slot for `tick`. Requires `mtx_` to be held.
+    void advance(std::uint64_t tick)
+    {
+        auto& slot = slots_[tick % slot_count];
+        auto i = std::size_t{0};
+        while (i < slot.size()) {
+            auto& e = slot[i];
+            if (e.due > tick) {  // A later revolution.
+                ++i;
+                continue;
+            }
+            auto fired = std::move(e);
+            e = std::move(slot.back());
+            slot.pop_back();
+            --size_;
+            if (fired.waiter) {
+                ox::Terminal::event_queue.enqueue(ox::event::Resume{fired.waiter});
+                continue;
+            }
+            if (fired.state->generation != fired.generation) { continue; }
+
+            auto& state = *fired.state;
+            if (state.pending.exchange(true)) { ++state.missed; }
+            else { ox::Terminal::event_queue.enqueue(ox::event::Timer{fired.id}); }
+
+            // Fixed rate from the previous due tick, so intervals don't drift.
+            fired.due = std::max(fired.due + fired.period, tick + 1);
+            this->insert(std::move(fired));
+        }
+    }
+
+    /// Returns the next tick with an occupied slot, or nothing if the wheel is empty.
+    [[nodiscard]] auto next_occupied() const -> std::optional<std::uint64_t>
+    {
+        if (size_ == 0) { return std::nullopt; }
+        for (auto i = std::size_t{0}; i < slot_count; ++i) {
+            auto const tick = next_tick_ + i;
+            if (!slots_[tick % slot_count].empty()) { return tick; }
+        }
+        return std::nullopt;
+    }
+
+    void run(std::stop_token st)
+    {
+        auto lock = std::unique_lock{mtx_};
+        while (!st.stop_requested()) {
+            auto const now = this->tick_of(Clock::now());
+            if (size_ == 0) { next_tick_ = now + 1; }
+            for (; next_tick_ <= now; ++next_tick_) { this->advance(next_tick_); }
+
+            changed_ = false;
+            auto const pred = [this] { return changed_; };
+            if (auto const next = this->next_occupied(); next.has_value()) {
+                wake_.wait_until(lock, st, start_ + std::chrono::milliseconds{*next},
+                                 pred);
+            }
+            else {
+                wake_.wait(lock, st, pred);
+            }
+        }
+    }
+
+   private:
+    Clock::time_point const start_ = Clock::now();
+    std::array<std::vector<Entry>, slot_count> slots_;
+    std::size_t size_ = 0;
+    std::uint64_t next_tick_ = 0;  // The first tick that has not been advanced.
+    bool changed_ = false;
+    std::mutex mtx_;
+    std::condition_variable_any wake_;
+    std::jthread thread_;  // Last, so it is joined before the members above go away.
+};
+
+}  // namespace
+
+namespace ox::detail {
+
+void resume_after(std::chrono::milliseconds delay, std::coroutine_handle<> h)
+{
+    TimerWheel::instance().schedule_once(delay, h);
+}
+
+}  // namespace ox::detail
+
 namespace ox {
 
 Timer::Timer(Widget& w, std::chrono::milliseconds duration, bool launch)
-    : id_{next_id_++}, duration_{duration}, timer_thread_{}
+    : id_{next_id_++}, duration_{duration}
 {
-    Application::timer_targets.emplace(std::pair{id_, track(w)});
+    Application::timer_targets.emplace(
+        std::pair{id_, Application::TimerTarget{.widget = track(w), .state = state_}});
     if (launch) { this->start(); }
 }
 
+// The moved-from Timer is left with a fresh state so start() and stop() stay valid.
 Timer::Timer(Timer&& other)
-{
-    id_ = std::move(other.id_);
-    other.id_ = -1;
-    duration_ = std::move(other.duration_);
-    timer_thread_ = std::move(other.timer_thread_);
-    is_running_ = std::move(other.is_running_);
-    other.is_running_ = false;
-}
+    : id_{std::exchange(other.id_, -1)},
+      duration_{other.duration_},
+      is_running_{std::exchange(other.is_running_, false)},
+      state_{std::exchange(other.state_, std::make_shared<detail::TimerState>())}
+{}
 
 auto Timer::operator=(Timer&& other) -> Timer&
 {
     if (this != &other) {
         if (this->is_running_) { this->stop(); }
-        id_ = std::move(other.id_);
-        other.id_ = -1;
-        duration_ = std::move(other.duration_);
-        timer_thread_ = std::move(other.timer_thread_);
-        is_running_ = std::move(other.is_running_);
-        other.is_running_ = false;
+        Application::timer_targets.erase(id_);
+        id_ = std::exchange(other.id_, -1);
+        duration_ = other.duration_;
+        is_running_ = std::exchange(other.is_running_, false);
+        state_ = std::exchange(other.state_, std::make_shared<detail::TimerState>());
     }
     return *this;
 }
@@ -51,16 +243,15 @@ Timer::~Timer()
 void Timer::start()
 {
     is_running_ = true;
-    timer_thread_ = zzz::TimerThread{
-        duration_,
-        [id = id_] { Terminal::event_queue.enqueue(event::Timer{id}); },
-    };
+    // Restarting invalidates the entry already in the wheel, if any.
+    auto const generation = ++state_->generation;
+    TimerWheel::instance().schedule(id_, state_, duration_, generation);
 }
 
 void Timer::stop()
 {
-    timer_thread_.request_stop();
+    ++state_->generation;
     is_running_ = false;
 }
 
-}  // namespace ox
\ No newline at end of file
+}  // namespace ox
@@ -1,9 +1,49 @@
 #include <ox/widget.hpp>
 
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <utility>
+#include <vector>
 
+#include <ox/core/core.hpp>
 #include <ox/focus.hpp>
 
+namespace {
+
+using namespace ox;
+
+// Bits for the fields of a Glyph that paint() wrote into a cached layer.
+constexpr auto symbol_field = std::uint8_t{1};
+constexpr auto background_field = std::uint8_t{2};
+constexpr auto foreground_field = std::uint8_t{4};
+constexpr auto traits_field = std::uint8_t{8};
+constexpr auto all_fields = std::uint8_t{15};
+
+// What a layer holds where paint() has not written. Every field of the first differs
+// from the second, so a field equal to one fill is known to be written if it is not
+// equal to the other. A paint() that writes whole Glyphs is only called once.
+auto const unwritten = std::array{
+    Glyph{.symbol = U'\uFFFF',
+          .brush = {.background = TrueColor{0x010203},
+                    .foreground = TrueColor{0x040506},
+                    .traits = Trait::Invisible}},
+    Glyph{},
+};
+
+/// Returns the fields of \p g that differ from \p fill.
+[[nodiscard]] auto changed_fields(Glyph const& g, Glyph const& fill) -> std::uint8_t
+{
+    auto fields = std::uint8_t{0};
+    if (g.symbol != fill.symbol) { fields |= symbol_field; }
+    if (g.brush.background != fill.brush.background) { fields |= background_field; }
+    if (g.brush.foreground != fill.brush.foreground) { fields |= foreground_field; }
+    if (g.brush.traits != fill.brush.traits) { fields |= traits_field; }
+    return fields;
+}
+
+}  // namespace
+
 namespace ox {
 
 Widget::Widget(FocusPolicy fp, SizePolicy sp) : focus_policy{fp}, size_policy{sp} {}
@@ -13,6 +53,7 @@ Widget::Widget(Widget&& other)
       size_policy{other.size_policy},
       cursor{other.cursor},
       active{other.active},
+      cache_paint{other.cache_paint},
       at{other.at},
       size{other.size},
       lifetime{std::move(other.lifetime)}
@@ -26,13 +67,135 @@ auto Widget::operator=(Widget&& other) -> Widget&
     size_policy = other.size_policy;
     cursor = other.cursor;
     active = other.active;
+    cache_paint = other.cache_paint;
     at = other.at;
     size = other.size;
 
     lifetime = std::move(other.lifetime);
     *lifetime = this;
+    this->update();
 
     return *this;
 }
 
+auto Widget::get_children() -> zzz::Generator<Widget&>
+{
+    auto children = std::vector<Widget*>{};
+    this->for_each_child([&](Widget& child) { children.push_back(&child); });
+    for (Widget* child : children) {
+        co_yield *child;
+    }
+}
+
+auto Widget::get_children() const -> zzz::Generator<Widget const&>
+{
+    auto children = std::vector<Widget const*>{};
+    this->for_each_child([&](Widget const& child) { children.push_back(&child); });
+    for (Widget const* child : children) {
+        co_yield *child;
+    }
+}
+
+auto Widget::child_at(Point p) -> Widget*
+{
+    Widget* found = nullptr;
+    this->for_each_child([&](Widget& child) {
+        if (found == nullptr && child.active && detail::contains(child, p)) {
+            found = &child;
+        }
+    });
+    return found;
+}
+
+void Widget::render(Canvas c)
+{
+    if (!cache_paint) {
+        layer_.reset();
+        this->paint(c);
+        return;
+    }
+
+    if (!layer_.has_value()) {
+        layer_.emplace(Layer{.update = 0,
+                             .runs{},
+                             .glyphs{},
+                             .fields{},
+                             .scratch = ScreenBuffer{c.size}});
+        layer_->scratch.fill(unwritten[0]);
+        layer_->scratch.track_written(true);
+        layer_->scratch.clear_damage();
+    }
+    auto& layer = *layer_;
+    auto& scratch = layer.scratch;
+
+    if (scratch.size() != c.size || layer.update != last_update_) {
+        if (scratch.size() != c.size) {
+            scratch.resize(c.size);
+            scratch.fill(unwritten[0]);
+            scratch.clear_damage();
+        }
+        layer.update = last_update_;
+        layer.runs.clear();
+        layer.glyphs.clear();
+        layer.fields.clear();
+        this->paint(Canvas{.buffer = scratch, .at = {0, 0}, .size = c.size});
+
+        // Only the written fields are kept, so the Canvas below shows through the rest.
+        auto const& painted = std::as_const(scratch);
+        auto ambiguous = false;
+        for (auto y = 0; y < c.size.height; ++y) {
+            auto const span = scratch.damage(y);
+            for (auto x = span.begin; x < span.end; ++x) {
+                if (!scratch.written({x, y})) { continue; }
+                auto const begin = x;
+                while (x < span.end && scratch.written({x, y})) {
+                    auto const& glyph = painted[{x, y}];
+                    layer.glyphs.push_back(glyph);
+                    layer.fields.push_back(::changed_fields(glyph, unwritten[0]));
+                    ambiguous = ambiguous || layer.fields.back() != all_fields;
+                    ++x;
+                }
+                layer.runs.push_back({.at = {begin, y}, .length = x - begin});
+            }
+        }
+
+        // A field left equal to the first fill is written if the second paint changes
+        // it to the same value over the second fill.
+        if (ambiguous) {
+            scratch.reset_damaged(unwritten[1]);
+            this->paint(Canvas{.buffer = scratch, .at = {0, 0}, .size = c.size});
+            auto fields = std::begin(layer.fields);
+            for (auto const& run : layer.runs) {
+                for (auto i = 0; i < run.length; ++i) {
+                    auto const& glyph = painted[{run.at.x + i, run.at.y}];
+                    *fields++ |= ::changed_fields(glyph, unwritten[1]);
+                }
+            }
+        }
+        scratch.reset_damaged(unwritten[0]);
+    }
+
+    auto glyph = std::cbegin(layer.glyphs);
+    auto fields = std::cbegin(layer.fields);
+    for (auto const& run : layer.runs) {
+        for (auto i = 0; i < run.length; ++i, ++glyph, ++fields) {
+            auto& cell = c[{run.at.x + i, run.at.y}];
+            if (*fields == all_fields) {
+                cell = *glyph;
+                continue;
+            }
+            if ((*fields & symbol_field) != 0) { cell.symbol = glyph->symbol; }
+            if ((*fields & background_field) != 0) {
+                cell.brush.background = glyph->brush.background;
+            }
+            if ((*fields & foreground_field) != 0) {
+                cell.brush.foreground = glyph->brush.foreground;
+            }
+            if ((*fields & traits_field) != 0) {
+                cell.brush.traits = glyph->brush.traits;
+            }
+        }
+    }
+}
+
 }  // namespace ox
\ No newline at end of file
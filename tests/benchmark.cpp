@@ -0,0 +1,289 @@
+#define TEST_MAIN
+#include <zzz/test.hpp>
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <esc/sequence.hpp>
+
+#include <ox/application.hpp>
+#include <ox/core/core.hpp>
+#include <ox/layout.hpp>
+#include <ox/widget.hpp>
+
+#include "check.hpp"
+
+namespace {
+
+/// Incremented by every call to the global operator new from the current thread.
+thread_local auto allocation_count = std::size_t{0};
+
+}  // namespace
+
+auto operator new(std::size_t size) -> void*
+{
+    ++allocation_count;
+    if (auto* const p = std::malloc(size); p != nullptr) { return p; }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+/**
+ * The previous ConcurrentQueue implementation, kept as a benchmark baseline.
+ */
+template <typename T>
+class ListQueue {
+   public:
+    void enqueue(T value)
+    {
+        auto tmp = std::list<T>{};
+        tmp.push_back(std::move(value));
+        {
+            auto const lock = std::scoped_lock{mutex_};
+            queue_.splice(std::end(queue_), tmp);
+        }
+        cond_.notify_one();
+    }
+
+    [[nodiscard]] auto pop() -> T
+    {
+        auto lock = std::unique_lock{mutex_};
+        cond_.wait(lock, [this] { return !queue_.empty(); });
+        auto value = std::move(queue_.front());
+        queue_.pop_front();
+        return value;
+    }
+
+   private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::list<T> queue_;
+};
+
+struct Message {
+    std::size_t producer;
+    std::size_t sequence;
+};
+
+/**
+ * Returns the time taken for \p producers threads to each enqueue \p count messages
+ * while a single consumer pops them all. Checks per-producer FIFO order.
+ */
+template <typename Queue>
+auto run_mpsc(Queue& queue, std::size_t producers, std::size_t count)
+    -> std::chrono::microseconds
+{
+    auto const begin = std::chrono::steady_clock::now();
+    {
+        auto threads = std::vector<std::jthread>{};
+        for (auto p = std::size_t{0}; p < producers; ++p) {
+            threads.emplace_back([&queue, p, count] {
+                for (auto i = std::size_t{0}; i < count; ++i) {
+                    queue.enqueue(Message{p, i});
+                }
+            });
+        }
+        auto next = std::vector<std::size_t>(producers, 0);
+        for (auto i = std::size_t{0}; i < producers * count; ++i) {
+            auto const message = queue.pop();
+            CHECK(message.sequence == next[message.producer]);
+            ++next[message.producer];
+        }
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - begin);
+}
+
+/**
+ * Returns the average number of allocations made to enqueue and pop one event built by
+ * \p make, measured after a warm up pass has grown any pooled storage.
+ */
+template <typename Queue, typename Make>
+auto allocations_per_event(Queue& queue, Make make) -> double
+{
+    constexpr auto count = std::size_t{10'000};
+    auto const round_trip = [&] {
+        for (auto i = std::size_t{0}; i < count; ++i) {
+            queue.enqueue(make());
+        }
+        for (auto i = std::size_t{0}; i < count; ++i) {
+            (void)queue.pop();
+        }
+    };
+    round_trip();
+    auto const before = allocation_count;
+    round_trip();
+    return (double)(allocation_count - before) / (double)count;
+}
+
+/**
+ * Returns a Row of \p count Widgets.
+ */
+auto make_leaves(int count) -> ox::Row<std::vector<ox::Widget>>
+{
+    auto row = ox::Row<std::vector<ox::Widget>>{};
+    for (auto i = 0; i < count; ++i) {
+        row.children.emplace_back();
+    }
+    return row;
+}
+
+/**
+ * Returns the number of Widgets below \p w, found through the get_children generators.
+ */
+auto count_descendants(ox::Widget const& w) -> std::size_t
+{
+    auto count = std::size_t{0};
+    for (auto const& child : w.get_children()) {
+        count += 1 + count_descendants(child);
+    }
+    return count;
+}
+
+}  // namespace
+
+TEST(concurrent_queue)
+{
+    constexpr auto producers = std::size_t{4};
+    constexpr auto count = std::size_t{50'000};
+
+    auto list_queue = ListQueue<Message>{};
+    auto const list_time = run_mpsc(list_queue, producers, count);
+
+    auto lock_free_queue = ox::ConcurrentQueue<Message>{};
+    auto const lock_free_time = run_mpsc(lock_free_queue, producers, count);
+
+    std::cout << producers << " producers x " << count << " messages, list + mutex: "
+              << list_time.count() << "us, lock-free: " << lock_free_time.count()
+              << "us\n";
+}
+
+TEST(concurrent_queue_idle)
+{
+    constexpr auto count = 2'000;
+
+    // Events arrive one at a time, so the consumer finds the queue empty before each.
+    auto queue = ox::ConcurrentQueue<int>{};
+    auto producer = std::jthread{[&queue] {
+        for (auto i = 0; i < count; ++i) {
+            std::this_thread::sleep_for(std::chrono::microseconds{500});
+            queue.enqueue(i);
+        }
+    }};
+
+    auto const thread_cpu_time = [] {
+        auto t = ::timespec{};
+        ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+        return std::chrono::seconds{t.tv_sec} + std::chrono::nanoseconds{t.tv_nsec};
+    };
+    auto const begin = thread_cpu_time();
+    for (auto i = 0; i < count; ++i) {
+        (void)queue.pop();
+    }
+    auto const cpu = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        thread_cpu_time() - begin);
+
+    std::cout << "consumer CPU time per sparse event: " << cpu.count() / count
+              << "ns\n";
+}
+
+TEST(custom_event_allocations)
+{
+    // A typical capture: a few pointers and values, too large for std::function's SBO.
+    auto const payload = std::array<std::uint64_t, 5>{1, 2, 3, 4, 5};
+
+    auto list_queue = ListQueue<std::function<ox::EventResponse()>>{};
+    auto const before = allocations_per_event(list_queue, [&] {
+        return std::function<ox::EventResponse()>{[payload]() -> ox::EventResponse {
+            return payload[0] == 0 ? ox::EventResponse{} : std::nullopt;
+        }};
+    });
+
+    auto event_queue = ox::ConcurrentQueue<ox::Event>{};
+    auto const after = allocations_per_event(event_queue, [&] {
+        return ox::Event{ox::event::Custom{[payload]() -> ox::EventResponse {
+            return payload[0] == 0 ? ox::EventResponse{} : std::nullopt;
+        }}};
+    });
+
+    std::cout << "allocations per Custom event, std::function + list queue: " << before
+              << ", InlineFunction + lock-free queue: " << after << '\n';
+}
+
+TEST(sgr_delta_byte_count)
+{
+    // A foreground gradient over a bold background, as painted by a Fade decoration.
+    auto full = std::string{};
+    auto delta = std::string{};
+    auto previous = ox::Brush{};
+    for (auto i = 0; i < 256; ++i) {
+        auto const brush = ox::Brush{
+            .background = ox::XColor::Black,
+            .foreground = ox::TrueColor{ox::RGB{(std::uint8_t)i, 0x80, 0xFF}},
+            .traits = ox::Trait::Bold,
+        };
+        full += escape(brush);
+        ox::detail::append_sgr_delta(delta, previous, brush);
+        previous = brush;
+    }
+
+    std::cout << "SGR bytes, full: " << full.size() << ", delta: " << delta.size()
+              << '\n';
+}
+
+TEST(child_traversal)
+{
+    // Four levels of tuple layouts over vector layouts, 64 leaves.
+    auto head = ox::Column{
+        ox::Row{ox::Column{make_leaves(8), make_leaves(8)},
+                ox::Column{make_leaves(8), make_leaves(8)}},
+        ox::Row{ox::Column{make_leaves(8), make_leaves(8)},
+                ox::Column{make_leaves(8), make_leaves(8)}},
+    };
+    auto app = ox::Application{head};
+    auto buffer = ox::ScreenBuffer{{.width = 64, .height = 8}};
+    (void)app.handle_resize(buffer.size());
+
+    constexpr auto frames = 10'000;
+    auto const before = allocation_count;
+    auto const begin = std::chrono::steady_clock::now();
+    for (auto i = 0; i < frames; ++i) {
+        (void)app.handle_mouse_move(
+            {.at = {.x = i % 64, .y = i % 8},
+             .button = ox::Mouse::Button::None,
+             .modifiers = {}});
+        (void)app.handle_paint(
+            ox::Canvas{.buffer = buffer, .at = {0, 0}, .size = buffer.size()});
+    }
+    auto const elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - begin);
+    auto const per_frame = (double)(allocation_count - before) / frames;
+
+    auto const generator_before = allocation_count;
+    auto const descendants = count_descendants(head);
+    auto const generator_walk = allocation_count - generator_before;
+
+    std::cout << "paint + mouse move frame, " << descendants
+              << " Widgets: " << elapsed.count() / frames << "ns, " << per_frame
+              << " allocations, one get_children walk: " << generator_walk
+              << " allocations\n";
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * Aborts the test run with the failed condition and its location if \p condition is
+ * false. Unlike assert, this is not compiled out when NDEBUG is defined.
+ */
+#define CHECK(condition)                                                          \
+    do {                                                                          \
+        if (!(condition)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+                         #condition);                                             \
+            std::abort();                                                         \
+        }                                                                         \
+    } while (false)
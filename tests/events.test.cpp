@@ -1,6 +1,837 @@
 #define TEST_MAIN
 #include <zzz/test.hpp>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <ox/animation.hpp>
+#include <ox/application.hpp>
 #include <ox/core/core.hpp>
+#include <ox/focus.hpp>
+#include <ox/layout.hpp>
+#include <ox/task.hpp>
+#include <ox/timer.hpp>
+#include <ox/widget.hpp>
+
+#include "check.hpp"
+
+namespace {
+
+/// Incremented by every call to the global operator new from the current thread, so
+/// threads left running by other tests are not counted.
+thread_local auto allocation_count = std::size_t{0};
+
+}  // namespace
+
+auto operator new(std::size_t size) -> void*
+{
+    ++allocation_count;
+    if (auto* const p = std::malloc(size); p != nullptr) { return p; }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+/**
+ * Returns the average number of allocations made to enqueue and pop one event built by
+ * \p make, measured after a warm up pass has grown any pooled storage.
+ */
+template <typename Queue, typename Make>
+auto allocations_per_event(Queue& queue, Make make) -> double
+{
+    constexpr auto count = std::size_t{10'000};
+    auto const round_trip = [&] {
+        for (auto i = std::size_t{0}; i < count; ++i) {
+            queue.enqueue(make());
+        }
+        for (auto i = std::size_t{0}; i < count; ++i) {
+            (void)queue.pop();
+        }
+    };
+    round_trip();
+    auto const before = allocation_count;
+    round_trip();
+    return (double)(allocation_count - before) / (double)count;
+}
+
+/**
+ * Fills itself with Glyphs of a symbol and counts how many times it has been painted.
+ */
+class PaintCounter : public ox::Widget {
+   public:
+    char32_t symbol;
+    int paints = 0;
+
+   public:
+    explicit PaintCounter(char32_t s) : symbol{s} {}
+
+   public:
+    void paint(ox::Canvas c) override
+    {
+        ++paints;
+        for (auto y = 0; y < c.size.height; ++y) {
+            for (auto x = 0; x < c.size.width; ++x) {
+                c[{x, y}] = ox::Glyph{.symbol = symbol};
+            }
+        }
+    }
+};
+
+/**
+ * Blocks the worker thread that runs it until released.
+ */
+class BlockingJob : public ox::detail::PoolJob {
+   public:
+    std::atomic<bool> started = false;
+    std::atomic<bool> released = false;
+
+   public:
+    void run() override
+    {
+        started = true;
+        while (!released) { std::this_thread::yield(); }
+    }
+};
+
+/**
+ * Counts the calls to run() and cancel().
+ */
+class CountingJob : public ox::detail::PoolJob {
+   public:
+    std::atomic<int> runs = 0;
+    std::atomic<int> cancels = 0;
+
+   public:
+    void run() override { ++runs; }
+
+    void cancel() override { ++cancels; }
+};
+
+/**
+ * Records the dt of each call to animate().
+ */
+class FrameRecorder : public ox::Widget {
+   public:
+    std::vector<std::chrono::nanoseconds> dts;
+
+   public:
+    void animate(std::chrono::nanoseconds dt) override { dts.push_back(dt); }
+};
+
+/**
+ * Returns the number of Widgets below \p w, found through the get_children generators.
+ */
+auto count_descendants(ox::Widget const& w) -> std::size_t
+{
+    auto count = std::size_t{0};
+    for (auto const& child : w.get_children()) {
+        count += 1 + count_descendants(child);
+    }
+    return count;
+}
+
+/**
+ * Returns a Row of \p count PaintCounters.
+ */
+auto make_leaves(int count) -> ox::Row<std::vector<PaintCounter>>
+{
+    auto row = ox::Row<std::vector<PaintCounter>>{};
+    for (auto i = 0; i < count; ++i) {
+        row.children.emplace_back(U'a');
+    }
+    return row;
+}
+
+/**
+ * Removes every event in the queue and returns how many were Timer events for \p id.
+ */
+auto drain_timer_events(int id) -> int
+{
+    auto count = 0;
+    for (auto const& event : ox::Terminal::event_queue.pop_all()) {
+        auto const* const timer = std::get_if<ox::event::Timer>(&event);
+        if (timer != nullptr && timer->id == id) { ++count; }
+    }
+    return count;
+}
+
+/**
+ * Waits up to \p timeout for a Timer event for \p id, discarding any other events.
+ */
+auto wait_for_timer_event(int id, std::chrono::milliseconds timeout) -> bool
+{
+    auto const deadline = std::chrono::steady_clock::now() + timeout;
+    while (auto const event = ox::Terminal::event_queue.try_pop_until(deadline)) {
+        auto const* const timer = std::get_if<ox::event::Timer>(&*event);
+        if (timer != nullptr && timer->id == id) { return true; }
+    }
+    return false;
+}
+
+}  // namespace
 
 TEST(event_construction) {}
+
+TEST(concurrent_queue_try_pop)
+{
+    auto queue = ox::ConcurrentQueue<int>{};
+    CHECK(!queue.try_pop().has_value());
+
+    queue.enqueue(1);
+    queue.enqueue(2);
+    CHECK(queue.try_pop() == 1);
+    CHECK(queue.try_pop() == 2);
+
+    auto const deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds{5};
+    CHECK(!queue.try_pop_until(deadline).has_value());
+    CHECK(std::chrono::steady_clock::now() >= deadline);
+
+    queue.enqueue(3);
+    CHECK(queue.try_pop_until(std::chrono::steady_clock::now()) == 3);
+}
+
+TEST(concurrent_queue_drain)
+{
+    auto queue = ox::ConcurrentQueue<int>{};
+    CHECK(queue.pop_all().empty());
+
+    for (auto i = 0; i < 5; ++i) {
+        queue.enqueue(i);
+    }
+    CHECK(queue.try_pop() == 0);  // Leaves the rest in the consumer's taken list.
+    queue.enqueue(5);
+
+    auto out = std::vector<int>{-1};
+    CHECK(queue.drain(out) == 5);
+    CHECK((out == std::vector<int>{-1, 1, 2, 3, 4, 5}));
+    CHECK(!queue.try_pop_for(std::chrono::milliseconds{1}).has_value());
+
+    queue.enqueue(6);
+    CHECK((queue.pop_all() == std::vector<int>{6}));
+}
+
+TEST(concurrent_queue_producer_order)
+{
+    constexpr auto producers = 4;
+    constexpr auto count = 10'000;
+
+    auto queue = ox::ConcurrentQueue<std::pair<int, int>>{};
+    auto threads = std::vector<std::jthread>{};
+    for (auto p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, p] {
+            for (auto i = 0; i < count; ++i) {
+                queue.enqueue({p, i});
+            }
+        });
+    }
+
+    // Each producer's messages arrive in the order they were sent.
+    auto next = std::vector<int>(producers, 0);
+    for (auto i = 0; i < producers * count; ++i) {
+        auto const [producer, sequence] = queue.pop();
+        CHECK(sequence == next[(std::size_t)producer]);
+        ++next[(std::size_t)producer];
+    }
+}
+
+TEST(concurrent_queue_destroys_remaining)
+{
+    auto queue = ox::ConcurrentQueue<std::string>{};
+    for (auto i = 0; i < 200; ++i) {
+        queue.enqueue(std::string(100, 'x'));
+    }
+    CHECK(queue.pop().size() == 100);
+}
+
+TEST(task_resumes_through_event_queue)
+{
+    auto const main_thread = std::this_thread::get_id();
+    auto result = 0;
+    auto caught = false;
+    auto done = false;
+
+    // The closure holds the captures, so it must outlive the suspended coroutine.
+    auto const flow = [&]() -> ox::Task {
+        result = co_await ox::run_in_pool([main_thread] {
+            return std::this_thread::get_id() == main_thread ? -1 : 42;
+        });
+        try {
+            co_await ox::run_in_pool([] { throw std::runtime_error{"pool"}; });
+        }
+        catch (std::runtime_error const&) {
+            caught = true;
+        }
+        co_await ox::sleep(std::chrono::milliseconds{1});
+        done = true;
+    };
+    flow();
+
+    // Resume events are the only ones posted here, handle them as process_events would.
+    while (!done) {
+        auto const event = ox::Terminal::event_queue.pop();
+        std::get<ox::event::Resume>(event).handle.resume();
+    }
+    CHECK(result == 42);
+    CHECK(caught);
+}
+
+TEST(task_exception_handler)
+{
+    auto errors = std::vector<std::string>{};
+    ox::Task::exception_handler = [&](std::exception_ptr e) {
+        try {
+            std::rethrow_exception(e);
+        }
+        catch (std::runtime_error const& x) {
+            errors.push_back(x.what());
+        }
+    };
+
+    // The frame holds a copy of the shared_ptr until the frame is destroyed.
+    auto const fail = [](std::shared_ptr<int>, bool suspend) -> ox::Task {
+        if (suspend) { co_await ox::sleep(std::chrono::milliseconds{1}); }
+        throw std::runtime_error{suspend ? "resumed" : "started"};
+    };
+
+    auto const alive = std::make_shared<int>(0);
+    fail(alive, false);
+    CHECK((errors == std::vector<std::string>{"started"}));
+    CHECK(alive.use_count() == 1);
+
+    // Thrown after being resumed, as from process_events, without escaping resume().
+    fail(alive, true);
+    CHECK(alive.use_count() == 2);
+    auto const event = ox::Terminal::event_queue.pop();
+    std::get<ox::event::Resume>(event).handle.resume();
+    CHECK((errors == std::vector<std::string>{"started", "resumed"}));
+    CHECK(alive.use_count() == 1);
+
+    ox::Task::exception_handler = nullptr;
+}
+
+TEST(application_submit)
+{
+    // Runs Custom events from the queue until \p done, as process_events would.
+    auto const run_until = [](auto const& done) {
+        while (!done()) {
+            auto const event = ox::Terminal::event_queue.pop();
+            (void)std::get<ox::event::Custom>(event).action();
+        }
+    };
+
+    auto sum = 0;
+    auto finished = 0;
+    for (auto i = 1; i <= 100; ++i) {
+        ox::Application::submit([i] { return i; },
+                                [&](int x) {
+                                    sum += x;
+                                    ++finished;
+                                });
+    }
+    run_until([&] { return finished == 100; });
+    CHECK(sum == 5050);
+
+    // Results for a destroyed Widget are dropped.
+    auto widget = std::make_unique<ox::Widget>();
+    auto const release = std::make_shared<std::atomic<bool>>(false);
+    auto cancelled_ran = false;
+    ox::Application::submit(
+        [release] {
+            while (!*release) { std::this_thread::yield(); }
+            return 1;
+        },
+        [&](int) { cancelled_ran = true; }, ox::track(*widget));
+    auto live_ran = false;
+    ox::Application::submit([] {}, [&] { live_ran = true; }, ox::track(*widget));
+    run_until([&] { return live_ran; });
+
+    widget.reset();
+    *release = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    while (auto const event = ox::Terminal::event_queue.try_pop()) {
+        (void)std::get<ox::event::Custom>(*event).action();
+    }
+    CHECK(!cancelled_ran);
+
+    // An exception from fn goes to Task::exception_handler instead of on_done.
+    auto errors = std::vector<std::string>{};
+    ox::Task::exception_handler = [&](std::exception_ptr e) {
+        try {
+            std::rethrow_exception(e);
+        }
+        catch (std::runtime_error const& x) {
+            errors.push_back(x.what());
+        }
+    };
+    auto failed_ran = false;
+    ox::Application::submit([]() -> int { throw std::runtime_error{"submit"}; },
+                            [&](int) { failed_ran = true; });
+    run_until([&] { return !errors.empty(); });
+    CHECK((errors == std::vector<std::string>{"submit"}));
+    CHECK(!failed_ran);
+    ox::Task::exception_handler = nullptr;
+}
+
+TEST(thread_pool_cancels_queued_jobs)
+{
+    using namespace std::chrono_literals;
+    auto blocker = BlockingJob{};
+    auto queued = CountingJob{};
+    auto pool = std::make_unique<ox::ThreadPool>(1);
+    pool->push(blocker);
+    while (!blocker.started) { std::this_thread::yield(); }
+    pool->push(queued);
+
+    // Released only once the destructor has asked the worker to stop.
+    auto const release = std::jthread{[&] {
+        std::this_thread::sleep_for(50ms);
+        blocker.released = true;
+    }};
+    pool.reset();
+    CHECK(queued.runs == 0 && queued.cancels == 1);
+}
+
+TEST(timer_pending_event)
+{
+    using namespace std::chrono_literals;
+    auto w = ox::Widget{};
+    auto app = ox::Application{w, ox::Terminal{{.output = [](std::string_view) {}}}};
+    auto t = ox::Timer{w, 2ms, true};
+
+    // Ticks while the first event is unhandled are counted, not posted.
+    std::this_thread::sleep_for(60ms);
+    CHECK(drain_timer_events(t.id()) == 1);
+    (void)app.handle_timer(t.id());
+    auto const first = t.missed_ticks();
+    CHECK(first >= 10);
+
+    // Handling the event lets the next tick post again, and the count restarts.
+    CHECK(wait_for_timer_event(t.id(), 1s));
+    std::this_thread::sleep_for(20ms);
+    (void)app.handle_timer(t.id());
+    CHECK(t.missed_ticks() >= 3 && t.missed_ticks() < first);
+
+    t.stop();
+    (void)drain_timer_events(t.id());
+}
+
+TEST(timer_moved_from)
+{
+    // Long enough that no Timer event is posted while the test runs.
+    auto const period = std::chrono::hours{1};
+    auto w = ox::Widget{};
+    auto a = ox::Timer{w, period, true};
+    auto b = std::move(a);
+    CHECK(b.is_running() && !a.is_running());
+
+    // A moved-from Timer can still be started and stopped.
+    a.start();
+    CHECK(a.is_running());
+    a.stop();
+    CHECK(!a.is_running() && a.missed_ticks() == 0);
+
+    auto c = ox::Timer{w, period};
+    c = std::move(b);
+    CHECK(c.is_running() && !b.is_running());
+    b.start();
+    b.stop();
+    c.stop();
+}
+
+TEST(timer_moved_keeps_firing)
+{
+    using namespace std::chrono_literals;
+    auto w = ox::Widget{};
+    auto app = ox::Application{w, ox::Terminal{{.output = [](std::string_view) {}}}};
+    auto b = std::optional<ox::Timer>{};
+    {
+        auto a = ox::Timer{w, 5ms, true};
+        b.emplace(std::move(a));
+    }  // Destroying the moved-from Timer must not stop the one it moved into.
+    CHECK(b->is_running());
+    CHECK(wait_for_timer_event(b->id(), 1s));
+    (void)app.handle_timer(b->id());
+    CHECK(wait_for_timer_event(b->id(), 1s));
+    (void)app.handle_timer(b->id());
+
+    // Assigning over a running Timer stops it, its id no longer fires.
+    auto c = ox::Timer{w, 5ms, true};
+    auto const replaced = c.id();
+    c = std::move(*b);
+    CHECK(c.is_running());
+    (void)drain_timer_events(replaced);
+    std::this_thread::sleep_for(30ms);
+    CHECK(drain_timer_events(replaced) == 0);
+
+    c.stop();
+    (void)drain_timer_events(c.id());
+}
+
+TEST(timer_wheel_laps)
+{
+    using namespace std::chrono_literals;
+    auto w = ox::Widget{};
+    // The short Timer keeps the wheel turning through every slot, so the long Timer's
+    // slot is reached twice before its deadline, 1100 ms is over two laps of 512.
+    auto fast = ox::Timer{w, 5ms};
+    auto slow = ox::Timer{w, 1100ms};
+    auto const start = std::chrono::steady_clock::now();
+    fast.start();
+    slow.start();
+    CHECK(wait_for_timer_event(slow.id(), 3s));
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+    // Ticks are whole milliseconds since the wheel started, so it can be up to 1 early.
+    CHECK(elapsed >= 1099ms && elapsed < 2s);
+
+    fast.stop();
+    slow.stop();
+    (void)drain_timer_events(fast.id());
+}
+
+TEST(animation_frame_clock)
+{
+    using namespace std::chrono_literals;
+    using Clock = ox::Animation::Clock;
+    auto w = FrameRecorder{};
+    auto a = ox::Animation{w};
+    CHECK(!ox::Animation::next_frame().has_value());
+
+    auto const before = Clock::now();
+    a.start();
+    auto const after = Clock::now();
+    auto const next = ox::Animation::next_frame();
+    CHECK(next.has_value() && *next >= before + ox::Animation::frame_interval &&
+          *next <= after + ox::Animation::frame_interval);
+
+    // The first dt is measured from start(), later ones from the previous frame.
+    ox::Animation::tick(after + 20ms);
+    CHECK(w.dts.size() == 1 && w.dts[0] >= 20ms && w.dts[0] <= after - before + 20ms);
+    CHECK(ox::Animation::next_frame() == after + 20ms + ox::Animation::frame_interval);
+    ox::Animation::tick(after + 50ms);
+    CHECK(w.dts.size() == 2 && w.dts[1] == 30ms);
+
+    // A late frame reports the whole gap, so speed doesn't depend on frame rate.
+    ox::Animation::tick(after + 250ms);
+    CHECK(w.dts.size() == 3 && w.dts[2] == 200ms);
+
+    // Stopping the last Animation stops the clock, and no more frames are animated.
+    a.stop();
+    CHECK(!ox::Animation::next_frame().has_value());
+    ox::Animation::tick(after + 300ms);
+    CHECK(w.dts.size() == 3);
+}
+
+TEST(update_count_threads)
+{
+    // Widgets built and updated on worker threads, as in Application::submit() work.
+    auto const before = ox::Widget::update_count();
+    auto const build = [] {
+        for (auto i = 0; i < 1'000; ++i) {
+            auto w = ox::Widget{};
+            w.update();
+        }
+    };
+    {
+        auto const a = std::jthread{build};
+        auto const b = std::jthread{build};
+    }
+    CHECK(ox::Widget::update_count() - before == 4'000);
+}
+
+TEST(retained_paint)
+{
+    auto head = ox::Row{PaintCounter{U'a'}, PaintCounter{U'b'}};
+    auto& a = ox::get_child<0>(head);
+    auto& b = ox::get_child<1>(head);
+    auto app = ox::Application{
+        head, ox::Terminal{{.paint_policy = {.retained = true}}}};
+
+    auto buffer = ox::ScreenBuffer{{.width = 4, .height = 2}};
+    (void)app.handle_resize(buffer.size());
+    auto const paint = [&] {
+        (void)app.handle_paint(
+            ox::Canvas{.buffer = buffer, .at = {0, 0}, .size = buffer.size()});
+    };
+
+    paint();
+    CHECK(a.paints == 1 && b.paints == 1);
+
+    // Nothing was updated, so nothing is painted.
+    paint();
+    CHECK(a.paints == 1 && b.paints == 1);
+
+    // Only the updated Widget is repainted, the other keeps its cells.
+    a.symbol = U'c';
+    a.update();
+    paint();
+    CHECK(a.paints == 2 && b.paints == 1);
+    CHECK((std::as_const(buffer)[{.x = 0, .y = 1}].symbol == U'c'));
+    CHECK((std::as_const(buffer)[{.x = 3, .y = 1}].symbol == U'b'));
+}
+
+TEST(paint_cache)
+{
+    auto head = ox::Row{PaintCounter{U'a'}, PaintCounter{U'b'}};
+    auto& a = ox::get_child<0>(head);
+    auto& b = ox::get_child<1>(head);
+    a.cache_paint = true;
+    auto app = ox::Application{head};
+
+    auto buffer = ox::ScreenBuffer{{.width = 4, .height = 2}};
+    (void)app.handle_resize(buffer.size());
+    auto const paint = [&] {
+        buffer.fill(ox::Glyph{});
+        (void)app.handle_paint(
+            ox::Canvas{.buffer = buffer, .at = {0, 0}, .size = buffer.size()});
+    };
+
+    // The cached Widget is copied from its layer instead of painted.
+    paint();
+    paint();
+    CHECK(a.paints == 1 && b.paints == 2);
+    CHECK((std::as_const(buffer)[{.x = 1, .y = 1}].symbol == U'a'));
+
+    a.symbol = U'c';
+    a.update();
+    paint();
+    CHECK(a.paints == 2);
+    CHECK((std::as_const(buffer)[{.x = 1, .y = 1}].symbol == U'c'));
+
+    // A new size paints the layer again.
+    buffer.resize({.width = 6, .height = 2});
+    (void)app.handle_resize(buffer.size());
+    a.paints = 0;
+    paint();
+    paint();
+    CHECK(a.paints == 1);
+}
+
+TEST(paint_cache_written_cells)
+{
+    // Sets the background of its top left cell and leaves the symbol as it is.
+    struct Tint : ox::Widget {
+        void paint(ox::Canvas c) override
+        {
+            c[{0, 0}].brush.background = ox::XColor::Red;
+        }
+    };
+
+    auto head = ox::Row{PaintCounter{U'\uFFFF'}, Tint{}};
+    auto& a = ox::get_child<0>(head);
+    auto& b = ox::get_child<1>(head);
+    a.cache_paint = true;
+    b.cache_paint = true;
+    auto app = ox::Application{head};
+
+    auto buffer = ox::ScreenBuffer{{.width = 4, .height = 2}};
+    (void)app.handle_resize(buffer.size());
+    for (auto i = 0; i < 2; ++i) {
+        buffer.fill(ox::Glyph{});
+        (void)app.handle_paint(
+            ox::Canvas{.buffer = buffer, .at = {0, 0}, .size = buffer.size()});
+
+        // Any symbol is kept, and a cell with only its Brush written is not dropped.
+        CHECK((std::as_const(buffer)[{.x = 1, .y = 1}].symbol == U'\uFFFF'));
+        CHECK((std::as_const(buffer)[{.x = 2, .y = 0}].brush.background ==
+               ox::Color{ox::XColor::Red}));
+        CHECK((std::as_const(buffer)[{.x = 3, .y = 0}] == ox::Glyph{}));
+    }
+}
+
+TEST(paint_cache_composites)
+{
+    // Writes a whole Glyph, then only a symbol, a background, a foreground and traits.
+    struct Mixed : ox::Widget {
+        int paints = 0;
+
+        void paint(ox::Canvas c) override
+        {
+            ++paints;
+            c[{0, 0}] = {.symbol = U'x', .brush = {.foreground = ox::XColor::Blue}};
+            c[{1, 0}].symbol = U'y';
+            c[{2, 0}].brush.background = ox::XColor::Red;
+            c[{3, 0}].brush.foreground = ox::XColor::Yellow;
+            c[{4, 0}].brush.traits = ox::Trait::Invisible;
+        }
+    };
+
+    auto cached = Mixed{};
+    cached.cache_paint = true;
+    auto fresh = Mixed{};
+    auto replayed = ox::ScreenBuffer{{.width = 6, .height = 1}};
+    auto painted = ox::ScreenBuffer{{.width = 6, .height = 1}};
+
+    // What is beneath changes each frame while the cached layer is replayed over it.
+    auto const beneath = std::array{
+        ox::Glyph{.symbol = U'a',
+                  .brush = {.background = ox::XColor::Green,
+                            .traits = ox::Trait::Bold}},
+        ox::Glyph{.symbol = U'\uFFFF',
+                  .brush = {.background = ox::TrueColor{0x010203},
+                            .foreground = ox::TrueColor{0x040506},
+                            .traits = ox::Trait::Invisible}},
+        ox::Glyph{},
+    };
+    for (auto const& below : beneath) {
+        for (auto* const buffer : {&replayed, &painted}) {
+            buffer->fill(below);
+        }
+        cached.render(ox::Canvas{.buffer = replayed, .at = {0, 0}, .size = {6, 1}});
+        fresh.render(ox::Canvas{.buffer = painted, .at = {0, 0}, .size = {6, 1}});
+        for (auto x = 0; x < 6; ++x) {
+            CHECK((std::as_const(replayed)[{x, 0}] == std::as_const(painted)[{x, 0}]));
+        }
+    }
+
+    // Fields left as the layer's fill are told apart by a second paint, once.
+    CHECK(cached.paints == 2 && fresh.paints == 3);
+}
+
+TEST(layout_child_at)
+{
+    auto row = ox::Row<std::vector<PaintCounter>>{};
+    for (auto i = 0; i < 50; ++i) {
+        row.children.emplace_back(U'a');
+    }
+    row.size = {.width = 100, .height = 1};
+    row.resize({});
+
+    for (auto x = 0; x < 100; ++x) {
+        CHECK(row.child_at({.x = x, .y = 0}) == &row.children[(std::size_t)(x / 2)]);
+    }
+    CHECK(row.child_at({.x = 100, .y = 0}) == nullptr);
+
+    // Inactive children are skipped, even before the next resize.
+    row.children[3].active = false;
+    CHECK(row.child_at({.x = 6, .y = 0}) == nullptr);
+    row.size = {.width = 98, .height = 1};
+    row.resize({});
+    CHECK(row.child_at({.x = 6, .y = 0}) == &row.children[4]);
+}
+
+TEST(tab_focus_chain)
+{
+    auto column = ox::Column<std::vector<PaintCounter>>{};
+    column.children.reserve(8);  // Keep addresses stable as children are added.
+    for (auto i = 0; i < 4; ++i) {
+        column.children.emplace_back(U'a');
+    }
+    auto& w = column.children;
+    w[0].focus_policy = ox::FocusPolicy::Tab;
+    w[2].focus_policy = ox::FocusPolicy::Strong;
+    w[3].focus_policy = ox::FocusPolicy::Click;
+    auto app = ox::Application{column};
+    (void)app.handle_resize({.width = 4, .height = 4});
+
+    auto const focused = [] { return &ox::Focus::get().get(); };
+    ox::Focus::set(w[0]);
+    (void)app.handle_key_press(ox::Key::Tab);
+    CHECK(focused() == &w[2]);
+    (void)app.handle_key_press(ox::Key::Tab);
+    CHECK(focused() == &w[0]);
+    (void)app.handle_key_press(ox::Key::BackTab);
+    CHECK(focused() == &w[2]);
+
+    // Focus policy changes are seen by the next key press.
+    w[1].focus_policy = ox::FocusPolicy::Tab;
+    (void)app.handle_key_press(ox::Key::BackTab);
+    CHECK(focused() == &w[1]);
+    w[2].focus_policy = ox::FocusPolicy::None;
+    (void)app.handle_key_press(ox::Key::Tab);
+    CHECK(focused() == &w[0]);
+
+    // Children added without a resize are found in both directions.
+    w.emplace_back(U'b').focus_policy = ox::FocusPolicy::Tab;
+    (void)app.handle_key_press(ox::Key::BackTab);
+    CHECK(focused() == &w[4]);
+    w.emplace_back(U'c').focus_policy = ox::FocusPolicy::Strong;
+    (void)app.handle_key_press(ox::Key::Tab);
+    CHECK(focused() == &w[5]);
+
+    // Removed children are skipped without being read.
+    ox::Focus::set(w[1]);
+    w.pop_back();
+    w.pop_back();
+    (void)app.handle_key_press(ox::Key::BackTab);
+    CHECK(focused() == &w[0]);
+    (void)app.handle_key_press(ox::Key::BackTab);
+    CHECK(focused() == &w[1]);
+
+    // Focus outside of the tree moves to the first or last focusable Widget.
+    auto outside = ox::Widget{ox::FocusPolicy::Strong};
+    ox::Focus::set(outside);
+    (void)app.handle_key_press(ox::Key::Tab);
+    CHECK(focused() == &w[0]);
+    ox::Focus::set(outside);
+    (void)app.handle_key_press(ox::Key::BackTab);
+    CHECK(focused() == &w[1]);
+
+    ox::Focus::clear();
+}
+
+TEST(custom_event_allocations)
+{
+    // A typical capture: a few pointers and values, too large for std::function's SBO.
+    auto const payload = std::array<std::uint64_t, 5>{1, 2, 3, 4, 5};
+
+    auto event_queue = ox::ConcurrentQueue<ox::Event>{};
+    auto const per_event = allocations_per_event(event_queue, [&] {
+        return ox::Event{ox::event::Custom{[payload]() -> ox::EventResponse {
+            return payload[0] == 0 ? ox::EventResponse{} : std::nullopt;
+        }}};
+    });
+    CHECK(per_event == 0);
+}
+
+TEST(traversal_allocations)
+{
+    // Four levels of tuple layouts over vector layouts, 64 leaves.
+    auto head = ox::Column{
+        ox::Row{ox::Column{make_leaves(8), make_leaves(8)},
+                ox::Column{make_leaves(8), make_leaves(8)}},
+        ox::Row{ox::Column{make_leaves(8), make_leaves(8)},
+                ox::Column{make_leaves(8), make_leaves(8)}},
+    };
+    auto app = ox::Application{head};
+    auto buffer = ox::ScreenBuffer{{.width = 64, .height = 8}};
+    (void)app.handle_resize(buffer.size());
+
+    constexpr auto frames = 100;
+    auto const frame = [&](int i) {
+        (void)app.handle_mouse_move(
+            {.at = {.x = i % 64, .y = i % 8},
+             .button = ox::Mouse::Button::None,
+             .modifiers = {}});
+        (void)app.handle_paint(
+            ox::Canvas{.buffer = buffer, .at = {0, 0}, .size = buffer.size()});
+    };
+    frame(0);
+
+    auto const before = allocation_count;
+    for (auto i = 0; i < frames; ++i) {
+        frame(i);
+    }
+    auto const per_frame = (double)(allocation_count - before) / frames;
+    CHECK(per_frame == 0);
+
+    CHECK(count_descendants(head) == 78);
+}
@@ -1,7 +1,239 @@
 #include <zzz/test.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <clocale>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <esc/sequence.hpp>
+
 #include <ox/core/core.hpp>
 
+#include "check.hpp"
+
+namespace {
+
+/**
+ * Decodes the frames written by Terminal::commit_changes() into a grid of symbols.
+ *
+ * @details Applies the cursor, erase, repeat and scroll sequences that commit_changes()
+ * uses. Colors and traits are not kept, SGR and private mode sequences are only
+ * recorded.
+ */
+class Screen {
+   public:
+    /// Every control sequence decoded, without its CSI, e.g. "2S" or "?25l".
+    std::vector<std::string> sequences;
+
+    /// Rows that a symbol has been written to or erased in.
+    std::set<int> touched_rows;
+
+   public:
+    explicit Screen(ox::Area size)
+        : size_{size},
+          cells_((std::size_t)(size.width * size.height), U' '),
+          bottom_{size.height - 1}
+    {}
+
+   public:
+    void feed(std::string_view bytes)
+    {
+        auto i = std::size_t{0};
+        while (i < bytes.size()) {
+            auto const byte = (unsigned char)bytes[i];
+            if (byte == '\033') {
+                CHECK(bytes[i + 1] == '[');
+                auto end = i + 2;
+                while (bytes[end] < 0x40 || bytes[end] > 0x7E) {
+                    ++end;
+                }
+                this->control(bytes.substr(i + 2, end - i - 1));
+                i = end + 1;
+            }
+            else if (byte == '\r') {
+                x_ = 0;
+                ++i;
+            }
+            else {
+                auto const length = byte < 0x80   ? 1
+                                    : byte < 0xE0 ? 2
+                                    : byte < 0xF0 ? 3
+                                                  : 4;
+                auto const mask = length == 1 ? 0x7F : 0xFF >> (length + 1);
+                auto symbol = (char32_t)(byte & mask);
+                for (auto k = std::size_t{1}; k < (std::size_t)length; ++k) {
+                    symbol = (symbol << 6) | ((unsigned char)bytes[i + k] & 0x3F);
+                }
+                this->print(symbol);
+                i += (std::size_t)length;
+            }
+        }
+    }
+
+    /// Returns row \p y, leaving out the cells covered by wide symbols.
+    [[nodiscard]] auto row(int y) const -> std::u32string
+    {
+        auto result = std::u32string{};
+        for (auto x = 0; x < size_.width; ++x) {
+            if (auto const symbol = this->at(x, y); symbol != U'\0') {
+                result += symbol;
+            }
+        }
+        return result;
+    }
+
+    /// Returns the number of sequences decoded that end with \p final.
+    [[nodiscard]] auto count(char final) const -> int
+    {
+        auto result = 0;
+        for (auto const& sequence : sequences) {
+            result += sequence.back() == final && sequence.front() != '?' ? 1 : 0;
+        }
+        return result;
+    }
+
+   private:
+    [[nodiscard]] auto at(int x, int y) const -> char32_t
+    {
+        return cells_[(std::size_t)(y * size_.width + x)];
+    }
+
+    [[nodiscard]] auto at(int x, int y) -> char32_t&
+    {
+        return cells_[(std::size_t)(y * size_.width + x)];
+    }
+
+    void print(char32_t symbol)
+    {
+        // The cursor waits at the last column until the next symbol wraps it.
+        if (x_ == size_.width) {
+            x_ = 0;
+            ++y_;
+        }
+        auto const width = symbol >= U'\u2E80' && symbol <= U'\u9FFF' ? 2 : 1;
+        CHECK(x_ >= 0 && x_ + width <= size_.width && y_ >= 0 && y_ < size_.height);
+        this->at(x_, y_) = symbol;
+        if (width == 2) { this->at(x_ + 1, y_) = U'\0'; }
+        touched_rows.insert(y_);
+        last_ = symbol;
+        x_ += width;
+    }
+
+    void erase(int begin, int end)
+    {
+        for (auto x = begin; x < std::min(end, size_.width); ++x) {
+            this->at(x, y_) = U' ';
+        }
+        touched_rows.insert(y_);
+    }
+
+    // Moves rows of the scroll region up by \p distance, or down if negative.
+    void scroll(int distance)
+    {
+        auto const before = cells_;
+        for (auto y = top_; y <= bottom_; ++y) {
+            auto const from = y + distance;
+            for (auto x = 0; x < size_.width; ++x) {
+                this->at(x, y) = from >= top_ && from <= bottom_
+                                     ? before[(std::size_t)(from * size_.width + x)]
+                                     : U' ';
+            }
+        }
+    }
+
+    void control(std::string_view sequence)
+    {
+        sequences.emplace_back(sequence);
+        if (sequence.front() == '?') { return; }  // Private modes, such as the cursor.
+
+        auto parameters = std::vector<int>{0};
+        for (auto c : sequence.substr(0, sequence.size() - 1)) {
+            if (c == ';') { parameters.push_back(0); }
+            else {
+                parameters.back() = parameters.back() * 10 + (c - '0');
+            }
+        }
+        auto const parameter = [&](std::size_t i) {
+            return i < parameters.size() && parameters[i] != 0 ? parameters[i] : 1;
+        };
+        auto const n = parameter(0);
+
+        switch (sequence.back()) {
+            case 'H':
+                y_ = n - 1;
+                x_ = parameter(1) - 1;
+                break;
+            case 'A': y_ -= n; break;
+            case 'B': y_ += n; break;
+            case 'C': x_ = std::min(x_ + n, size_.width - 1); break;
+            case 'D': x_ -= n; break;
+            case 'G': x_ = n - 1; break;
+            case 'd': y_ = n - 1; break;
+            case 'X': this->erase(x_, x_ + n); break;
+            case 'K': this->erase(x_, size_.width); break;
+            case 'b':
+                for (auto i = 0; i < n; ++i) {
+                    this->print(last_);
+                }
+                break;
+            case 'r':
+                top_ = n - 1;
+                bottom_ = parameters.size() > 1 ? parameter(1) - 1 : size_.height - 1;
+                x_ = 0;
+                y_ = 0;
+                break;
+            case 'S': this->scroll(n); break;
+            case 'T': this->scroll(-n); break;
+            case 'm': break;
+            default: CHECK(false);
+        }
+    }
+
+   private:
+    ox::Area size_;
+    std::vector<char32_t> cells_;
+    int x_ = 0;
+    int y_ = 0;
+    int top_ = 0;
+    int bottom_;
+    char32_t last_ = U' ';
+};
+
+/**
+ * Returns a Terminal that appends each frame to \p out instead of writing to stdout.
+ */
+auto make_terminal(std::string& out, ox::Terminal::Capabilities capabilities = {})
+    -> ox::Terminal
+{
+    return ox::Terminal{{
+        .capabilities = capabilities,
+        .output = [&out](std::string_view frame) { out += frame; },
+    }};
+}
+
+/**
+ * Writes each symbol of \p rows to \p changes, from the top left.
+ */
+void paint(ox::ScreenBuffer& changes, std::vector<std::u32string> const& rows)
+{
+    for (auto y = 0; y < (int)rows.size(); ++y) {
+        for (auto x = 0; x < (int)rows[(std::size_t)y].size(); ++x) {
+            changes[{x, y}] = ox::Glyph{rows[(std::size_t)y][(std::size_t)x]};
+        }
+    }
+}
+
+}  // namespace
+
 TEST(terminal_construction)
 {
     // struct {
@@ -12,4 +244,337 @@ TEST(terminal_construction)
     // auto sb = ox::ScreenBuffer{{.width = 20, .height = 10}};
 
     // auto c = ox::Painter{widget};
-}
\ No newline at end of file
+}
+
+TEST(screen_buffer_damage)
+{
+    auto sb = ox::ScreenBuffer{{.width = 20, .height = 10}};
+    CHECK(sb.damage_count() == 20 * 10);
+
+    sb.clear_damage();
+    CHECK(sb.damage_count() == 0);
+    CHECK(sb.damage(3).empty());
+
+    sb[{.x = 4, .y = 3}] = ox::Glyph{U'a'};
+    sb[{.x = 9, .y = 3}] = ox::Glyph{U'b'};
+    auto c = ox::Canvas{.buffer = sb, .at = {2, 5}, .size = {5, 5}};
+    c[{.x = 1, .y = 1}].symbol = U'c';
+
+    CHECK(sb.damage(3).begin == 4 && sb.damage(3).end == 10);
+    CHECK(sb.damage(6).begin == 3 && sb.damage(6).end == 4);
+    CHECK(sb.damage_count() == 7);
+
+    // Reads through a const ScreenBuffer are not damage.
+    [[maybe_unused]] auto const& g = std::as_const(sb)[{.x = 0, .y = 0}];
+    CHECK(sb.damage(0).empty());
+
+    sb.reset_damaged(ox::Glyph{});
+    CHECK(sb.damage_count() == 0);
+    CHECK((std::as_const(sb)[{.x = 9, .y = 3}] == ox::Glyph{}));
+}
+
+TEST(screen_buffer_written)
+{
+    auto sb = ox::ScreenBuffer{{.width = 10, .height = 2}};
+    sb.track_written(true);
+    CHECK(sb.written({.x = 9, .y = 1}));
+
+    sb.clear_damage();
+    sb[{.x = 2, .y = 0}].brush.background = ox::XColor::Red;
+    sb[{.x = 6, .y = 0}] = ox::Glyph{U'a'};
+    CHECK(sb.written({.x = 2, .y = 0}) && sb.written({.x = 6, .y = 0}));
+    CHECK(!sb.written({.x = 4, .y = 0}) && !sb.written({.x = 2, .y = 1}));
+
+    sb.reset_damaged(ox::Glyph{});
+    CHECK(!sb.written({.x = 2, .y = 0}));
+}
+
+TEST(sgr_delta_byte_count)
+{
+    // A foreground gradient over a bold background, as painted by a Fade decoration.
+    auto brushes = std::vector<ox::Brush>{};
+    for (auto i = 0; i < 256; ++i) {
+        brushes.push_back({
+            .background = ox::XColor::Black,
+            .foreground = ox::TrueColor{ox::RGB{(std::uint8_t)i, 0x80, 0xFF}},
+            .traits = ox::Trait::Bold,
+        });
+    }
+
+    auto full = std::string{};
+    auto delta = std::string{};
+    auto previous = ox::Brush{};
+    for (auto const& brush : brushes) {
+        full += escape(brush);
+        ox::detail::append_sgr_delta(delta, previous, brush);
+        previous = brush;
+    }
+
+    CHECK(delta.size() < full.size());
+
+    // Removing a Trait must not leave it set.
+    auto removed = std::string{};
+    ox::detail::append_sgr_delta(removed, {.traits = ox::Trait::Bold}, {});
+    CHECK(!removed.empty());
+}
+
+TEST(event_coalescing)
+{
+    auto const move = [](int x, ox::Mouse::Button button) -> ox::Event {
+        return esc::MouseMove{
+            ox::Mouse{.at = {x, 0}, .button = button, .modifiers = {}}};
+    };
+    auto const none = ox::Terminal::EventCoalescing{};
+    auto const all = ox::Terminal::EventCoalescing{.mouse_move = true, .resize = true};
+
+    auto const left_1 = move(1, ox::Mouse::Button::Left);
+    auto const left_2 = move(2, ox::Mouse::Button::Left);
+    auto const right_3 = move(3, ox::Mouse::Button::Right);
+    auto const resize_1 = ox::Event{esc::Resize{{10, 10}}};
+    auto const resize_2 = ox::Event{esc::Resize{{20, 20}}};
+
+    CHECK(!ox::is_superseded(left_1, left_2, none));
+    CHECK(ox::is_superseded(left_1, left_2, all));
+    CHECK(!ox::is_superseded(left_2, right_3, all));
+    CHECK(!ox::is_superseded(left_2, resize_1, all));
+    CHECK(ox::is_superseded(resize_1, resize_2, all));
+    CHECK(!ox::is_superseded(resize_1, resize_2, {.mouse_move = true}));
+}
+
+TEST(max_frame_rate_under_flood)
+{
+    struct PaintCounter {
+        int paints = 0;
+
+        auto handle_paint(ox::Canvas) -> ox::Terminal::Cursor
+        {
+            ++paints;
+            return std::nullopt;
+        }
+    };
+
+    // Each event posts the next, so the queue is never empty, until a quit request.
+    struct Flood {
+        std::chrono::steady_clock::time_point end;
+
+        auto operator()() const -> ox::EventResponse
+        {
+            if (std::chrono::steady_clock::now() < end) {
+                ox::Terminal::event_queue.enqueue(ox::event::Custom{*this});
+                return {};
+            }
+            return ox::QuitRequest{0};
+        }
+    };
+
+    constexpr auto rate = 50;
+    constexpr auto duration = std::chrono::milliseconds{500};
+
+    auto term = ox::Terminal{{
+        .paint_policy = {.max_frame_rate = rate},
+        .output = [](std::string_view) {},
+    }};
+    ox::Terminal::event_queue.enqueue(
+        ox::event::Custom{Flood{std::chrono::steady_clock::now() + duration}});
+    auto handler = PaintCounter{};
+    CHECK(ox::process_events(term, handler) == 0);
+
+    auto const expected = rate * duration.count() / 1'000;
+    CHECK(handler.paints >= expected / 2);
+    CHECK(handler.paints <= expected + 5);
+}
+
+TEST(commit_scroll_region)
+{
+    auto const rows = std::vector<std::u32string>{
+        U"aaaaaaaa", U"bbbbbbbb", U"cccccccc", U"dddddddd", U"eeeeeeee", U"ffffffff",
+    };
+    auto out = std::string{};
+    auto term = make_terminal(out);
+    term.changes.resize({.width = 8, .height = 6});
+    auto screen = Screen{{.width = 8, .height = 6}};
+
+    auto const commit = [&](std::vector<std::u32string> const& next) {
+        paint(term.changes, next);
+        term.commit_changes();
+        screen.sequences.clear();
+        screen.touched_rows.clear();
+        screen.feed(out);
+        out.clear();
+        for (auto y = 0; y < 6; ++y) {
+            CHECK(screen.row(y) == next[(std::size_t)y]);
+        }
+    };
+    commit(rows);
+
+    // Shifted up by two rows, one scroll moves the rest and only new rows are written.
+    auto const up = std::vector<std::u32string>{
+        rows[2], rows[3], rows[4], rows[5], U"gggggggg", U"hhhhhhhh",
+    };
+    commit(up);
+    CHECK(screen.count('S') == 1 && screen.count('T') == 0);
+    CHECK(std::ranges::find(screen.sequences, "2S") != std::cend(screen.sequences));
+    CHECK((screen.touched_rows == std::set<int>{4, 5}));
+    CHECK(term.frame_stats().scrolled_rows == 2);
+
+    auto const down = std::vector<std::u32string>{
+        U"zzzzzzzz", up[0], up[1], up[2], up[3], up[4],
+    };
+    commit(down);
+    CHECK(screen.count('T') == 1 && screen.count('S') == 0);
+    CHECK((screen.touched_rows == std::set<int>{0}));
+    CHECK(term.frame_stats().scrolled_rows == -1);
+
+    // Without scroll_region every moved row is written again.
+    term.capabilities.scroll_region = false;
+    commit(rows);
+    CHECK(screen.count('S') == 0 && screen.count('T') == 0 && screen.count('r') == 0);
+    CHECK(screen.touched_rows.size() == 6);
+    CHECK(term.frame_stats().scrolled_rows == 0);
+}
+
+TEST(commit_cursor_moves)
+{
+    // Wide symbols only advance the cursor by two columns where wcwidth() knows them.
+    auto const previous_locale = std::string{std::setlocale(LC_CTYPE, nullptr)};
+    auto const wide_known = std::setlocale(LC_CTYPE, "C.UTF-8") != nullptr;
+
+    auto out = std::string{};
+    auto term = make_terminal(out);
+    term.changes.resize({.width = 20, .height = 6});
+    term.changes.fill(ox::Glyph{U' '});
+    term.commit_changes();
+    auto screen = Screen{{.width = 20, .height = 6}};
+    screen.feed(out);
+    out.clear();
+
+    term.changes[{.x = 2, .y = 1}] = ox::Glyph{U'a'};
+    term.changes[{.x = 9, .y = 1}] = ox::Glyph{U'b'};
+    term.changes[{.x = 0, .y = 2}] = ox::Glyph{U'c'};
+    term.changes[{.x = 15, .y = 2}] = ox::Glyph{U'd'};
+    term.changes[{.x = 4, .y = 3}] = ox::Glyph{U'世'};
+    term.changes[{.x = 11, .y = 3}] = ox::Glyph{U'e'};
+    term.changes[{.x = 12, .y = 5}] = ox::Glyph{U'f'};
+    term.commit_changes();
+
+    auto const contains = [&](std::string_view bytes) {
+        return out.find(bytes) != std::string::npos;
+    };
+    // Each move is the shortest of CUP, CUF/CUB with CR or CHA, and CUU/CUD or VPA.
+    CHECK(contains("a\033[6Cb"));
+    CHECK(contains("b\033[B\rc"));
+    CHECK(contains("c\033[14Cd"));
+    CHECK(contains("d\033[4;5H世"));
+    CHECK(contains("e\033[2Bf"));
+
+    // The cursor is two columns past 世, not one.
+    if (wide_known) { CHECK(contains("世\033[5Ce")); }
+
+    screen.feed(out);
+    CHECK(screen.row(1) == U"  a      b          ");
+    CHECK(screen.row(2) == U"c              d    ");
+    CHECK(screen.row(3) == U"    世     e        ");
+    CHECK(screen.row(5) == U"            f       ");
+
+    std::setlocale(LC_CTYPE, previous_locale.c_str());
+}
+
+TEST(commit_run_encoding)
+{
+    auto const rows = std::vector<std::u32string>{
+        U"a                    b                  ",
+        U"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx",
+    };
+
+    // Returns the output of committing `rows` over a screen filled with 'q'.
+    auto const commit = [&](ox::Terminal::Capabilities capabilities) {
+        auto out = std::string{};
+        auto term = make_terminal(out, capabilities);
+        term.changes.resize({.width = 40, .height = 2});
+        term.changes.fill(ox::Glyph{U'q'});
+        term.commit_changes();
+        paint(term.changes, rows);
+        auto screen = Screen{{.width = 40, .height = 2}};
+        screen.feed(out);
+        out.clear();
+        term.commit_changes();
+        screen.sequences.clear();
+        screen.feed(out);
+        CHECK(screen.row(0) == rows[0] && screen.row(1) == rows[1]);
+        return std::pair{out, screen};
+    };
+
+    // Neither erase nor repeat is assumed by default.
+    auto const [plain, plain_screen] = commit({});
+    CHECK(plain_screen.count('X') == 0 && plain_screen.count('K') == 0);
+    CHECK(plain_screen.count('b') == 0);
+
+    // ECH inside the row, then CUF past the erased cells, and EL at its end.
+    auto const [erased, erased_screen] = commit({.erase = true});
+    CHECK(erased.find("a\033[20X\033[20Cb\033[K") != std::string::npos);
+    CHECK(erased_screen.count('b') == 0);
+    CHECK(erased.size() < plain.size());
+
+    // REP for both runs, it is shorter than ECH with CUF for the blanks.
+    auto const [repeated, repeated_screen] = commit({.repeat = true});
+    CHECK(repeated.find("a \033[19bb \033[17b") != std::string::npos);
+    CHECK(repeated.find("x\033[39b") != std::string::npos);
+    CHECK(repeated_screen.count('X') == 0 && repeated_screen.count('K') == 0);
+    CHECK(repeated.size() < plain.size());
+}
+
+TEST(commit_coalesces_under_backpressure)
+{
+    // The first write blocks until released, as a slow terminal would.
+    auto mtx = std::mutex{};
+    auto cv = std::condition_variable{};
+    auto released = false;
+    auto writes = 0;
+    auto written = std::string{};
+
+    auto const frame = [](char32_t symbol) {
+        return std::vector<std::u32string>(3, std::u32string(6, symbol));
+    };
+    auto coalesced = 0;
+    {
+        auto term = ox::Terminal{{
+            .threaded_output = true,
+            .output =
+                [&](std::string_view bytes) {
+                    auto lock = std::unique_lock{mtx};
+                    written += bytes;
+                    ++writes;
+                    cv.notify_all();
+                    cv.wait(lock, [&] { return released; });
+                },
+        }};
+        term.changes.resize({.width = 6, .height = 3});
+
+        paint(term.changes, frame(U'a'));
+        term.commit_changes();
+        {
+            auto lock = std::unique_lock{mtx};
+            cv.wait(lock, [&] { return writes == 1; });
+        }
+
+        // The first frame waits on the writer, later frames each replace it.
+        for (auto symbol : std::u32string{U"bcde"}) {
+            paint(term.changes, frame(symbol));
+            term.commit_changes();
+            coalesced += term.frame_stats().coalesced ? 1 : 0;
+        }
+        {
+            auto const lock = std::scoped_lock{mtx};
+            released = true;
+        }
+        cv.notify_all();
+    }  // Writes the pending frame.
+
+    CHECK(coalesced == 3);
+    CHECK(writes == 2);
+    auto screen = Screen{{.width = 6, .height = 3}};
+    screen.feed(written);
+    for (auto y = 0; y < 3; ++y) {
+        CHECK(screen.row(y) == U"eeeeee");
+    }
+}